@@ -0,0 +1,335 @@
+// Microbenchmarks for the ADT walkers and the ops, run on synthetic ADTs.
+//
+// Every case reports the time, heap allocations and bytes copied per op.
+// Bytes copied are the bytes of the output that had to be materialized in
+// memory rather than referenced from the input, which is what the output
+// writer has to move on top of what the kernel copies.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+#include "adt.h"
+#include "adt_generator.h"
+#include "adt_index.h"
+#include "adt_modder.h"
+#include "allocation_counter.h"
+#include "argparse/argparse.hpp"
+#include "fmt/core.h"
+#include "nlohmann/json.hpp"
+#include "op_plan.h"
+
+namespace {
+
+const AdtShape kShapes[] = {
+    {"small", 256, 8, 4, 8, 4, 64},
+    {"wide", 4096, 64, 3, 16, 4, 256},
+    {"deep", 2048, 2, 16, 8, 4, 64},
+    {"fat", 512, 8, 4, 128, 4, 4096},
+};
+
+struct Measurement {
+  double ns_per_op;
+  double allocations_per_op;
+  double copied_per_op;
+};
+
+// Runs `iteration` until `min_time` has been spent in it, calling `setup`
+// untimed before every run. Each run performs `ops` ops and returns the bytes
+// it copied.
+Measurement Measure(std::chrono::nanoseconds min_time, size_t ops,
+                    const std::function<void()> &setup,
+                    const std::function<size_t()> &iteration) {
+  using Clock = std::chrono::steady_clock;
+  std::chrono::nanoseconds elapsed{0};
+  size_t runs = 0;
+  size_t allocations = 0;
+  size_t copied = 0;
+  while (elapsed < min_time || runs < 3) {
+    setup();
+    const size_t allocations_before = AllocationCount();
+    const auto start = Clock::now();
+    copied += iteration();
+    elapsed += Clock::now() - start;
+    allocations += AllocationCount() - allocations_before;
+    runs++;
+  }
+
+  const double total_ops = static_cast<double>(runs * ops);
+  return {static_cast<double>(elapsed.count()) / total_ops,
+          static_cast<double>(allocations) / total_ops,
+          static_cast<double>(copied) / total_ops};
+}
+
+void Report(const AdtShape &shape, std::string_view name,
+            const Measurement &measurement) {
+  fmt::print("{:<6} {:<32} {:>12.1f} {:>10.2f} {:>12.1f}\n", shape.name, name,
+             measurement.ns_per_op, measurement.allocations_per_op,
+             measurement.copied_per_op);
+}
+
+size_t CopiedBytes(const ExtentList &extents) {
+  size_t copied = 0;
+  for (const auto &extent : extents.Extents()) {
+    if (extent.input_offset == ExtentList::kNotInInput) {
+      copied += extent.size;
+    }
+  }
+  return copied;
+}
+
+// Benchmarks only run on valid ADTs and ops, so any failure is fatal
+void Check(bool ok, std::string_view what) {
+  if (!ok) {
+    fmt::print("{} failed\n", what);
+    std::exit(1);
+  }
+}
+
+void BenchWalkers(const AdtShape &shape, GeneratedAdt &adt,
+                  std::chrono::nanoseconds min_time, std::mt19937_64 &rng) {
+  void *data = adt.data.data();
+  const auto nothing = [] {};
+
+  Report(shape, "adt_validate", Measure(min_time, 1, nothing, [&] {
+           Check(adt_validate(data, adt.data.size()) == 0, "adt_validate");
+           return size_t{0};
+         }));
+
+  Report(shape, "adt_path_offset",
+         Measure(min_time, adt.paths.size(), nothing, [&] {
+           for (const auto &path : adt.paths) {
+             Check(adt_path_offset(data, path.c_str()) >= 0, path);
+           }
+           return size_t{0};
+         }));
+
+  Report(shape, "adt_path_offset_unchecked",
+         Measure(min_time, adt.paths.size(), nothing, [&] {
+           for (const auto &path : adt.paths) {
+             Check(adt_path_offset_unchecked(data, path.c_str()) >= 0, path);
+           }
+           return size_t{0};
+         }));
+
+  // Full pre-order traversal, one op per node visited
+  std::function<size_t(int)> walk = [&](int offset) {
+    size_t count = 1;
+    int child = offset;
+    ADT_FOREACH_CHILD(data, child) { count += walk(child); }
+    return count;
+  };
+  const size_t nodes = adt.paths.size() + 1;
+  Report(shape, "adt_next_sibling_offset walk",
+         Measure(min_time, nodes, nothing, [&] {
+           Check(walk(0) == nodes, "walk");
+           return size_t{0};
+         }));
+
+  std::vector<std::pair<int, const std::string *>> lookups;
+  for (size_t i = 0; i < 1024; i++) {
+    const auto &path = adt.paths[rng() % adt.paths.size()];
+    lookups.push_back({adt_path_offset(data, path.c_str()),
+                       &adt.property_names[rng() % adt.property_names.size()]});
+  }
+  Report(shape, "adt_getprop", Measure(min_time, lookups.size(), nothing, [&] {
+           for (const auto &[offset, name] : lookups) {
+             u32 size;
+             Check(adt_getprop(data, offset, name->c_str(), &size) != nullptr,
+                   *name);
+           }
+           return size_t{0};
+         }));
+
+  Report(shape, "AdtIndex::Build", Measure(min_time, 1, nothing, [&] {
+           Check(AdtIndex::Build(adt.data).is_ok(), "AdtIndex::Build");
+           return size_t{0};
+         }));
+}
+
+// Json for `count` ops of the given kind, on random nodes and properties.
+// Structural ops never target the same node and property twice.
+nlohmann::json MakeOps(std::string_view kind, const GeneratedAdt &adt,
+                       size_t count, std::mt19937_64 &rng) {
+  nlohmann::json ops = nlohmann::json::array();
+  std::vector<size_t> nodes(adt.paths.size());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i] = i;
+  }
+  std::shuffle(nodes.begin(), nodes.end(), rng);
+
+  for (size_t i = 0; i < count; i++) {
+    const std::string &node = adt.paths[nodes[i % nodes.size()]];
+    const std::string &property =
+        adt.property_names[rng() % adt.property_names.size()];
+    nlohmann::json op;
+    op["name"] = std::string{kind};
+    if (kind == "add_node") {
+      op["node"] = fmt::format("{}/bench{}", node, i);
+    } else {
+      op["node"] = node;
+    }
+    if (kind == "replace_property" || kind == "randomize_property" ||
+        kind == "zero_out_property" || kind == "delete_property") {
+      op["property"] =
+          kind == "delete_property" ? adt.property_names[i / nodes.size()]
+                                    : property;
+    }
+    if (kind == "replace_property") {
+      op["value"] = "x";
+    }
+    if (kind == "add_property") {
+      op["property"] = fmt::format("bench{}", i);
+      op["value"] = {{"type", "u32"}, {"contents", "0x1234"}};
+    }
+    ops.push_back(op);
+  }
+  return ops;
+}
+
+void BenchOps(const AdtShape &shape, const GeneratedAdt &adt,
+              std::chrono::nanoseconds min_time, size_t ops_per_run,
+              std::mt19937_64 &rng) {
+  const std::pair<const char *, AdtModder::Mode> modes[] = {
+      {"immediate", AdtModder::Mode::Immediate},
+      {"edit-log", AdtModder::Mode::EditLog},
+      {"tree", AdtModder::Mode::Tree},
+  };
+
+  std::vector<uint8_t> work;
+  const auto reset = [&] { work = adt.data; };
+
+  for (const auto &kind : OpPlan::Names()) {
+    const size_t count = std::min(
+        ops_per_run, kind == "delete_property"
+                         ? adt.paths.size() * adt.property_names.size()
+                         : adt.paths.size());
+    auto plan = OpPlan::Compile(MakeOps(kind, adt, count, rng));
+    Check(plan.is_ok(), kind);
+    plan.ok_value().SetSeed(1);
+
+    for (const auto &[mode_name, mode] : modes) {
+      AdtModder modder{mode};
+      modder.SetVerbose(false);
+      Report(shape, fmt::format("{} {}", kind, mode_name),
+             Measure(min_time, count, reset, [&] {
+               auto extents = modder.RunToExtents(
+                   {work.data(), work.size()}, plan.ok_value());
+               Check(extents.is_ok(), kind);
+               return CopiedBytes(extents.ok_value());
+             }));
+    }
+
+    if (plan.ok_value().PreservesLayout()) {
+      AdtModder modder;
+      modder.SetVerbose(false);
+      Report(shape, fmt::format("{} in-place", kind),
+             Measure(min_time, count, reset, [&] {
+               Check(modder
+                         .RunInPlace({work.data(), work.size()},
+                                     plan.ok_value())
+                         .is_ok(),
+                     kind);
+               return size_t{0};
+             }));
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder_bench");
+  program.add_argument("--shape")
+      .help("Only run the named shape: small, wide, deep, fat or custom")
+      .default_value(std::string{});
+  program.add_argument("--nodes")
+      .help("Node count of the custom shape")
+      .default_value(1024)
+      .scan<'i', int>();
+  program.add_argument("--fan-out")
+      .help("Fan-out of the custom shape")
+      .default_value(8)
+      .scan<'i', int>();
+  program.add_argument("--depth")
+      .help("Depth of the custom shape")
+      .default_value(6)
+      .scan<'i', int>();
+  program.add_argument("--properties")
+      .help("Properties per node of the custom shape")
+      .default_value(16)
+      .scan<'i', int>();
+  program.add_argument("--min-value-size")
+      .help("Smallest property value of the custom shape")
+      .default_value(4)
+      .scan<'i', int>();
+  program.add_argument("--max-value-size")
+      .help("Largest property value of the custom shape")
+      .default_value(256)
+      .scan<'i', int>();
+  program.add_argument("--ops")
+      .help("Ops per run in the op benchmarks")
+      .default_value(32)
+      .scan<'i', int>();
+  program.add_argument("--min-time-ms")
+      .help("Minimum time spent measuring each case")
+      .default_value(200)
+      .scan<'i', int>();
+  program.add_argument("--seed")
+      .help("Seed for the generated ADTs and ops")
+      .default_value(1)
+      .scan<'i', int>();
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    return 1;
+  }
+
+  std::vector<AdtShape> shapes;
+  const auto only = program.get<std::string>("--shape");
+  for (const auto &shape : kShapes) {
+    if (only.empty() || only == shape.name) {
+      shapes.push_back(shape);
+    }
+  }
+  if (only == "custom") {
+    const auto arg = [&](const char *name) {
+      return static_cast<uint32_t>(std::max(program.get<int>(name), 1));
+    };
+    // replace_property writes a one character string, which needs two bytes
+    shapes.push_back({"custom", arg("--nodes"), arg("--fan-out"),
+                      arg("--depth"), arg("--properties"),
+                      std::max<uint32_t>(arg("--min-value-size"), 2),
+                      arg("--max-value-size")});
+  }
+  if (shapes.empty()) {
+    fmt::print("Unknown shape {}\n", only);
+    return 1;
+  }
+
+  const std::chrono::milliseconds min_time{program.get<int>("--min-time-ms")};
+  const auto ops_per_run =
+      static_cast<size_t>(std::max(program.get<int>("--ops"), 1));
+  std::mt19937_64 rng{static_cast<uint64_t>(program.get<int>("--seed"))};
+
+  for (const auto &shape : shapes) {
+    auto adt = GenerateAdt(shape, rng());
+    if (adt.paths.empty()) {
+      fmt::print("Shape {} has no nodes besides the root\n", shape.name);
+      return 1;
+    }
+    fmt::print("\n{}: {} nodes, {} properties per node, {} bytes\n",
+               shape.name, adt.paths.size() + 1, shape.properties + 1,
+               adt.data.size());
+    fmt::print("{:<6} {:<32} {:>12} {:>10} {:>12}\n", "shape", "case",
+               "ns/op", "allocs/op", "copied B/op");
+
+    BenchWalkers(shape, adt, min_time, rng);
+    BenchOps(shape, adt, min_time, ops_per_run, rng);
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "adt_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+
+#include "adt_tree.h"
+#include "fmt/core.h"
+
+namespace {
+
+void AddProperties(AdtTree &tree, AdtTree::Node *node,
+                   const AdtShape &shape,
+                   const std::vector<std::string> &names,
+                   std::mt19937_64 &rng) {
+  std::uniform_real_distribution<double> exponent{0.0, 1.0};
+  const double ratio = static_cast<double>(shape.max_value_size) /
+                       std::max<uint32_t>(shape.min_value_size, 1);
+
+  std::vector<uint8_t> value;
+  for (const auto &name : names) {
+    const auto size = static_cast<size_t>(
+        std::max<uint32_t>(shape.min_value_size, 1) *
+        std::pow(ratio, exponent(rng)));
+    value.resize(std::min<size_t>(size, shape.max_value_size));
+    for (auto &byte : value) {
+      byte = static_cast<uint8_t>(rng());
+    }
+    tree.AddProperty(node, name, {value.data(), value.size()});
+  }
+}
+
+} // namespace
+
+GeneratedAdt GenerateAdt(const AdtShape &shape, uint64_t seed) {
+  GeneratedAdt generated;
+  for (uint32_t i = 0; i < shape.properties; i++) {
+    generated.property_names.push_back(fmt::format("prop-{}", i));
+  }
+
+  std::mt19937_64 rng{seed};
+  AdtTree tree;
+  const char root_name[] = "device-tree";
+  tree.AddProperty(tree.Root(), "name",
+                   {reinterpret_cast<const uint8_t *>(root_name),
+                    sizeof(root_name)});
+  AddProperties(tree, tree.Root(), shape, generated.property_names, rng);
+
+  struct Pending {
+    AdtTree::Node *node;
+    std::string path;
+    uint32_t depth;
+  };
+  std::deque<Pending> pending{{tree.Root(), "", 0}};
+
+  uint32_t count = 1;
+  while (!pending.empty() && count < shape.nodes) {
+    const Pending parent = std::move(pending.front());
+    pending.pop_front();
+    if (parent.depth == shape.depth) {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < shape.fan_out && count < shape.nodes; i++) {
+      const std::string name =
+          count % 4 == 0 ? fmt::format("dev{}@{:x}", count, count * 0x1000)
+                         : fmt::format("node{}", count);
+      AdtTree::Node *child = tree.AddChild(parent.node, name);
+      AddProperties(tree, child, shape, generated.property_names, rng);
+
+      std::string path = parent.path + "/" + name;
+      generated.paths.push_back(path);
+      pending.push_back({child, std::move(path), parent.depth + 1});
+      count++;
+    }
+  }
+
+  generated.data.resize(tree.Size());
+  tree.Serialize({generated.data.data(), generated.data.size()});
+  return generated;
+}
@@ -0,0 +1,38 @@
+#ifndef ADT_GENERATOR_H_
+#define ADT_GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shape of a synthetic ADT
+struct AdtShape {
+  std::string name;
+  // Total number of nodes, root included
+  uint32_t nodes;
+  // Maximum number of children per node
+  uint32_t fan_out;
+  // Maximum depth of a node, the root being at depth 0
+  uint32_t depth;
+  // Properties per node, besides "name"
+  uint32_t properties;
+  // Property values sizes are log-uniformly distributed in [min, max], which
+  // skews them towards small values, as in real ADTs
+  uint32_t min_value_size;
+  uint32_t max_value_size;
+};
+
+struct GeneratedAdt {
+  std::vector<uint8_t> data;
+  // Path of every node but the root, in breadth-first order
+  std::vector<std::string> paths;
+  // Names of the properties every node has, besides "name"
+  std::vector<std::string> property_names;
+};
+
+// Generates a valid ADT of the given shape. Nodes are filled breadth-first,
+// so the tree is as shallow as the fan-out allows. One node in four gets a
+// unit address, as in "dev12@c000". The same seed always yields the same ADT.
+GeneratedAdt GenerateAdt(const AdtShape &shape, uint64_t seed);
+
+#endif // ADT_GENERATOR_H_
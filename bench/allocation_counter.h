@@ -0,0 +1,10 @@
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <cstddef>
+
+// Number of heap allocations made through operator new so far. The benchmark
+// executable replaces the global operator new to count them.
+size_t AllocationCount();
+
+#endif // ALLOCATION_COUNTER_H_
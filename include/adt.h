@@ -47,6 +47,17 @@ struct adt_node_hdr {
 /* Basic sanity check */
 int adt_check_header(void *adt);
 
+/*
+ * Checks the whole ADT in a single linear pass: every node and property must
+ * be aligned and lie within the `size` bytes of the buffer, every property
+ * name must be NUL-terminated, and every node but the root must have a
+ * NUL-terminated "name". Returns 0 or a negative ADT_ERR_* code.
+ *
+ * Once an ADT has been validated, the *_unchecked walkers below can be used
+ * on it, until it is modified.
+ */
+int adt_validate(const void *adt, size_t size);
+
 static inline int adt_get_property_count(void *adt, int offset) {
   return ADT_NODE(adt, offset)->property_count;
 }
@@ -59,7 +70,7 @@ static inline int adt_first_property_offset(void *adt, int offset) {
 static inline int adt_next_property_offset(void *adt, int offset) {
   struct adt_property *prop = ADT_PROP(adt, offset);
   return offset + sizeof(struct adt_property) +
-         ((prop->size + ADT_ALIGN - 1) & ~(ADT_ALIGN - 1));
+         ((ADT_SIZE(prop) + ADT_ALIGN - 1) & ~(ADT_ALIGN - 1));
 }
 
 static inline struct adt_property *adt_get_property_by_offset(void *adt,
@@ -80,6 +91,13 @@ int adt_subnode_offset(void *adt, int parentoffset, const char *name);
 int adt_path_offset(void *adt, const char *path);
 int adt_path_offset_trace(void *adt, const char *path, int *offsets);
 
+/* Same as above, without the header checks. Only for validated ADTs. */
+int adt_subnode_offset_namelen_unchecked(void *adt, int parentoffset,
+                                         const char *name, size_t namelen);
+int adt_path_offset_unchecked(void *adt, const char *path);
+int adt_path_offset_trace_unchecked(void *adt, const char *path,
+                                    int *offsets);
+
 const char *adt_get_name(void *adt, int nodeoffset);
 struct adt_property *adt_get_property_namelen(void *adt, int nodeoffset,
                                               const char *name, size_t namelen);
@@ -0,0 +1,79 @@
+#ifndef ADT_ADDRESS_MAP_H_
+#define ADT_ADDRESS_MAP_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "adt_index.h"
+
+// Physical address windows of every node with a "reg" property, translated
+// in a single pass over an AdtIndex.
+//
+// Addresses are translated like adt_get_reg() does, through the "ranges" of
+// every ancestor up to the first one without them. The #address-cells,
+// #size-cells and ranges of each node are decoded once, when it is visited,
+// and reused for all of its descendants. Windows are kept sorted by address
+// in an implicit interval tree, so the windows containing an address are
+// found in logarithmic time.
+class AdtAddressMap {
+public:
+  struct Window {
+    uint64_t address;
+    uint64_t size;
+    // Index of the node in the AdtIndex, and of the entry in its "reg"
+    uint32_t node;
+    uint32_t entry;
+
+    [[nodiscard]] uint64_t End() const {
+      return size > UINT64_MAX - address ? UINT64_MAX : address + size;
+    }
+  };
+
+  static AdtAddressMap Build(uint8_t *adt, const AdtIndex &index);
+
+  // Every window, sorted by address
+  [[nodiscard]] const std::vector<Window> &Windows() const {
+    return m_windows;
+  }
+  // Returns the windows containing `address`, sorted by address. Nested
+  // windows, like a device inside a bus, are all returned.
+  [[nodiscard]] std::vector<Window> Find(uint64_t address) const;
+
+private:
+  // An entry of "ranges", mapping addresses of the children of a node to
+  // addresses of its parent
+  struct Range {
+    uint64_t child;
+    uint64_t parent;
+    uint64_t size;
+  };
+
+  // Translation parameters of a node, applying to the addresses of its
+  // children
+  struct Bus {
+    uint32_t address_cells = 2;
+    uint32_t size_cells = 1;
+    // Whether the cells are ones adt_get_reg() can decode
+    bool valid = true;
+    // Whether the node has "ranges". Translation stops at nodes without.
+    bool has_ranges = false;
+    std::vector<Range> ranges;
+  };
+
+  // Translates an address of the bus of `node` to a physical address
+  static uint64_t Translate(const AdtIndex &index,
+                            const std::vector<Bus> &buses, uint32_t node,
+                            uint64_t address, uint64_t size);
+  // Computes the largest window end of every subtree of the implicit tree
+  // over [begin, end), returning the one of the whole range
+  uint64_t BuildMaxEnds(size_t begin, size_t end);
+  void Find(size_t begin, size_t end, uint64_t address,
+            std::vector<Window> &windows) const;
+
+  std::vector<Window> m_windows;
+  // Largest window end in the subtree of the implicit tree rooted at each
+  // window
+  std::vector<uint64_t> m_max_ends;
+};
+
+#endif // ADT_ADDRESS_MAP_H_
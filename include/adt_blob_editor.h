@@ -0,0 +1,52 @@
+#ifndef ADT_BLOB_EDITOR_H_
+#define ADT_BLOB_EDITOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "adt_index.h"
+#include "adt_modder.h"
+#include "adt_path_cache.h"
+#include "adt_property_index.h"
+
+// Editor that modifies the serialized ADT directly. Structural edits resize
+// the buffer and shift its tail as they happen, while the index, path cache
+// and property index are updated incrementally.
+class AdtBlobEditor : public AdtModder::Editor {
+public:
+  static Ditto::Result<AdtBlobEditor, AdtModder::Error>
+  Create(std::vector<uint8_t> &adt) noexcept;
+
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindNode(std::string_view path) override;
+  void PinNodes(Ditto::span<const uint32_t> nodes) override;
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindPinnedNode(uint32_t node) override;
+  Ditto::Result<Ditto::span<uint8_t>, AdtModder::Error>
+  FindProperty(AdtModder::Node node, std::string_view name) override;
+
+  AdtModder::Result AddNode(std::string_view path) override;
+  AdtModder::Result AddProperty(AdtModder::Node node, std::string_view name,
+                                Ditto::span<const uint8_t> value) override;
+  AdtModder::Result DeleteProperty(AdtModder::Node node,
+                                   std::string_view name) override;
+  void FindProperties(
+      AdtModder::Node node, Ditto::span<const std::string_view> names,
+      std::vector<std::optional<Ditto::span<uint8_t>>> &values) override;
+
+private:
+  AdtBlobEditor(std::vector<uint8_t> &adt, AdtIndex index)
+      : m_adt(adt), m_index(std::move(index)) {
+    m_counters.peak_adt_size = adt.size();
+  }
+
+  // Resizes the buffer, keeping track of reallocations and peak size
+  void Resize(size_t size);
+
+  std::vector<uint8_t> &m_adt;
+  AdtIndex m_index;
+  AdtPathCache m_paths;
+  AdtPropertyIndex m_properties;
+};
+
+#endif // ADT_BLOB_EDITOR_H_
@@ -0,0 +1,52 @@
+#ifndef ADT_BUILDER_H_
+#define ADT_BUILDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ditto/result.h"
+#include "nlohmann/json.hpp"
+
+// Compiles a json description of a tree into an ADT.
+//
+// The description uses the layout AdtDumper writes: every node is
+// {"name": ..., "properties": {...}, "children": [...]}, all of them optional
+// except the name of non-root nodes. The "name" of a node is only written as
+// a property when its properties lack one. Property values are strings, or
+// the lists of strings and tagged values typed dumps write, so those build
+// back into the same bytes. The typed objects of add_property are rejected,
+// their u32 is 8 bytes wide.
+//
+// The description is walked twice. The first pass checks it and computes the
+// exact size of the ADT, the second one writes every node into a buffer
+// allocated once, with that size.
+class AdtBuilder {
+public:
+  // With `hex_values`, string values are the hex encoded bytes of the
+  // property, like dumps without typed decoding write them
+  explicit AdtBuilder(bool hex_values) : m_hex_values(hex_values) {}
+
+  Ditto::Result<std::vector<uint8_t>, std::string>
+  Build(const nlohmann::ordered_json &root);
+
+private:
+  // Returns the size of the ADT described by `root`
+  Ditto::Result<size_t, std::string>
+  Measure(const nlohmann::ordered_json &root);
+  Ditto::Result<size_t, std::string>
+  MeasureValue(const nlohmann::ordered_json &value);
+  // Whether a value measured last by MeasureValue() has a null byte, like
+  // adt_validate() requires of node names
+  bool IsTerminated(const nlohmann::ordered_json &value) const;
+  void Write(const nlohmann::ordered_json &root, uint8_t *adt);
+  // Writes a property value measured by MeasureValue(), returning its size
+  size_t WriteValue(const nlohmann::ordered_json &value, uint8_t *out);
+
+  bool m_hex_values;
+  // Typed values are encoded while measuring, and written in the same order
+  std::vector<std::vector<uint8_t>> m_encoded;
+  size_t m_next_encoded = 0;
+};
+
+#endif // ADT_BUILDER_H_
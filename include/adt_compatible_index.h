@@ -0,0 +1,31 @@
+#ifndef ADT_COMPATIBLE_INDEX_H_
+#define ADT_COMPATIBLE_INDEX_H_
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "adt_index.h"
+
+// Compatible string -> nodes carrying it, built in a single pass over an
+// AdtIndex.
+//
+// Every string of the "compatible" property of a node is indexed, so a node
+// compatible with "wlan-pcie,bcm4378" and "wlan,bcm4378" is found under both.
+// Strings are referenced from the ADT, which must outlive the index and not be
+// modified.
+class AdtCompatibleIndex {
+public:
+  static AdtCompatibleIndex Build(uint8_t *adt, const AdtIndex &index);
+
+  // Returns the indices in the AdtIndex of the nodes compatible with
+  // `compatible`, in the order they appear in the ADT
+  [[nodiscard]] const std::vector<uint32_t> &
+  Find(std::string_view compatible) const;
+
+private:
+  std::unordered_map<std::string_view, std::vector<uint32_t>> m_nodes;
+};
+
+#endif // ADT_COMPATIBLE_INDEX_H_
@@ -0,0 +1,58 @@
+#ifndef ADT_DUMP_H_
+#define ADT_DUMP_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "ditto/result.h"
+#include "ditto/span.h"
+#include "fileio.h"
+#include "fmt/format.h"
+
+// Streams an ADT as json, walking the blob once. Output is buffered and
+// written out in chunks, so besides one value of the largest property, memory
+// use only grows with the depth of the tree.
+//
+// Every node is written as {"name": ..., "properties": {...},
+// "children": [...]}, without a name if it is a root lacking one. Property
+// values are written as hex strings. With typed decoding, printable values are
+// written as strings, or arrays of strings, 8 byte values as {"u64": n},
+// multiples of 4 bytes as {"u32": n} or {"u32": [n, ...]}, and anything else
+// as {"hex": "..."}. Both forms build back into the same bytes (see
+// AdtBuilder). Json strings can only hold bytes above 0x7f as UTF-8, so node
+// names with such bytes are written as {"hex": "..."}, and property names with
+// them, which are object keys, can't be dumped.
+class AdtDumper {
+public:
+  AdtDumper(File &out, bool typed) : m_out(out), m_typed(typed) {}
+
+  // Returns the first property name of the subtree at `offset` that can't
+  // be dumped, if any
+  static std::optional<std::string> FindUnwritableName(uint8_t *adt,
+                                                       int offset);
+
+  // Writes the subtree at `offset` of an ADT checked with adt_validate()
+  Ditto::Result<void, File::Error> Dump(uint8_t *adt, int offset);
+
+private:
+  // Writes a node up to the start of its children, returning the offset of
+  // its first child
+  int WriteNode(uint8_t *adt, int offset);
+  void WriteValue(Ditto::span<const uint8_t> value);
+  void WriteString(std::string_view string);
+  void WriteHex(Ditto::span<const uint8_t> value);
+  // Writes the value as {"hex": "..."}
+  void WriteTaggedHex(Ditto::span<const uint8_t> value);
+  // Writes the buffer out once it grows past kFlushSize, or always if `force`
+  Ditto::Result<void, File::Error> Flush(bool force);
+
+  static constexpr size_t kFlushSize = 64 * 1024;
+
+  File &m_out;
+  bool m_typed;
+  fmt::memory_buffer m_buffer;
+};
+
+#endif // ADT_DUMP_H_
@@ -0,0 +1,119 @@
+#ifndef ADT_EDIT_LOG_H_
+#define ADT_EDIT_LOG_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "adt_index.h"
+#include "adt_modder.h"
+#include "adt_path_cache.h"
+#include "adt_property_index.h"
+#include "extent_list.h"
+
+// Editor that defers structural edits.
+//
+// The original ADT keeps its layout for the whole run: values of existing
+// properties are modified in place, while added nodes and properties and
+// deleted properties are recorded against their original offsets. Once all
+// ops have run, the final size is known up front and Emit() produces the
+// edited ADT in a single forward merge over the original, either copying every
+// byte exactly once or as a list of extents for the output writer.
+class AdtEditLog : public AdtModder::Editor {
+public:
+  static Ditto::Result<AdtEditLog, AdtModder::Error>
+  Create(Ditto::span<uint8_t> adt) noexcept;
+
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindNode(std::string_view path) override;
+  void PinNodes(Ditto::span<const uint32_t> nodes) override;
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindPinnedNode(uint32_t node) override;
+  Ditto::Result<Ditto::span<uint8_t>, AdtModder::Error>
+  FindProperty(AdtModder::Node node, std::string_view name) override;
+
+  AdtModder::Result AddNode(std::string_view path) override;
+  AdtModder::Result AddProperty(AdtModder::Node node, std::string_view name,
+                                Ditto::span<const uint8_t> value) override;
+  AdtModder::Result DeleteProperty(AdtModder::Node node,
+                                   std::string_view name) override;
+
+  // True if no structural edit was recorded, in which case the original
+  // buffer already holds the result.
+  [[nodiscard]] bool IsInPlace() const { return m_edits.empty(); }
+
+  [[nodiscard]] size_t FinalSize() const { return m_final_size; }
+
+  // Sorted, non-overlapping ranges of the original ADT handed out by
+  // FindProperty(), which the ops may have written to
+  [[nodiscard]] std::vector<AdtModder::Range> TouchedRanges() const;
+
+  // Describes the edited ADT as ranges of the original interleaved with new
+  // bytes. `out` must have been created on the original ADT.
+  void Emit(ExtentList &out) const;
+  // Writes the edited ADT to `out`, which must be FinalSize() bytes long.
+  void Emit(Ditto::span<uint8_t> out) const;
+
+private:
+  struct PendingProperty {
+    std::string name;
+    std::vector<uint8_t> value;
+
+    [[nodiscard]] size_t Size() const;
+    uint8_t *Serialize(uint8_t *out) const;
+  };
+
+  struct PendingNode {
+    std::vector<PendingProperty> properties;
+    std::vector<std::unique_ptr<PendingNode>> children;
+
+    [[nodiscard]] size_t Size() const;
+    uint8_t *Serialize(uint8_t *out) const;
+  };
+
+  // Edits recorded against a node of the original ADT
+  struct NodeEdits {
+    std::vector<PendingProperty> added_properties;
+    std::vector<uint32_t> deleted_properties;
+    std::vector<std::unique_ptr<PendingNode>> added_children;
+  };
+
+  AdtEditLog(Ditto::span<uint8_t> adt, AdtIndex index)
+      : m_adt(adt), m_index(std::move(index)), m_final_size(adt.size()) {
+    m_counters.peak_adt_size = m_final_size;
+  }
+
+  static PendingNode *Pending(AdtModder::Node node) {
+    return static_cast<PendingNode *>(node.handle);
+  }
+
+  std::optional<AdtModder::Node> ResolveNode(std::string_view path);
+  static PendingProperty *
+  FindPendingProperty(std::vector<PendingProperty> &props,
+                      std::string_view name);
+  PendingNode *FindPendingChild(AdtModder::Node parent, std::string_view name);
+  // Like AdtIndex::ChildIndex(), matching renamed nodes by their current name
+  uint32_t FindOriginalChild(uint32_t parent, std::string_view name);
+  int FindOriginalProperty(uint32_t node_offset, std::string_view name);
+  // Forgets the paths that may resolve differently once `node` is renamed
+  void OnRename(AdtModder::Node node);
+
+  Ditto::span<uint8_t> m_adt;
+  AdtIndex m_index;
+  AdtPathCache m_paths;
+  AdtPropertyIndex m_properties;
+  std::unordered_map<std::string, PendingNode *> m_pending_paths;
+  // Original nodes with an added or deleted "name" property, whose name may
+  // not be the one in the index
+  std::unordered_set<uint32_t> m_renamed;
+  std::map<uint32_t, NodeEdits> m_edits;
+  std::vector<AdtModder::Range> m_touched;
+  size_t m_final_size;
+};
+
+#endif // ADT_EDIT_LOG_H_
@@ -0,0 +1,122 @@
+#ifndef ADT_INDEX_H_
+#define ADT_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ditto/result.h"
+#include "ditto/span.h"
+
+// Flat structural index of a serialized ADT, built in a single pass.
+//
+// Nodes are stored in the same pre-order they have in the blob, so inside the
+// index the first child of node `i` is `i + 1` and its next sibling is
+// `i + subtree_size`. Offsets are monotonically increasing, which lets us map
+// an offset back to its node with a binary search.
+//
+// Only the offset of every node is stored, the rest of its fields are
+// relative to it. Edits to the property list of a node shift the offsets of
+// every later node, which is recorded in a Fenwick tree of shifts instead of
+// being applied to each of them.
+class AdtIndex {
+public:
+  enum class Error {
+    TooLarge,
+    OutOfBounds,
+    Misaligned,
+  };
+
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  struct Node {
+    uint32_t offset;
+    // Index of the parent node, kNone for the root
+    uint32_t parent;
+    uint32_t first_property;
+    uint32_t first_child;
+    // One past the last byte of the subtree
+    uint32_t end;
+    // Number of nodes in the subtree, including this one
+    uint32_t subtree_size;
+    // Offset and size of the value of the "name" property. `name` is kNone if
+    // the node has no name.
+    uint32_t name;
+    uint32_t name_size;
+  };
+
+  static Ditto::Result<AdtIndex, Error> Build(Ditto::span<uint8_t> adt);
+
+  [[nodiscard]] size_t size() const { return m_nodes.size(); }
+  Node operator[](size_t index) const;
+
+  // Returns the name of the node at `index`, empty if it has none
+  [[nodiscard]] std::string_view Name(const uint8_t *adt,
+                                      uint32_t index) const;
+  // Returns the path of the node at `index`, made of the names of its
+  // ancestors
+  [[nodiscard]] std::string Path(const uint8_t *adt, uint32_t index) const;
+
+  // Returns the index of the node at the given offset, or kNone
+  [[nodiscard]] uint32_t Find(int offset) const;
+
+  // These mirror the adt.c walkers, returning offsets or negative ADT_ERR_*
+  // codes, but never re-walk the tree.
+  [[nodiscard]] int FirstChildOffset(int offset) const;
+  [[nodiscard]] int NextSiblingOffset(int offset) const;
+  int SubnodeOffset(const uint8_t *adt, int parent_offset,
+                    std::string_view name) const;
+  int PathOffset(const uint8_t *adt, std::string_view path) const;
+
+  // Returns the index of the first child of `parent` matching `name`, or
+  // kNone.
+  uint32_t ChildIndex(const uint8_t *adt, uint32_t parent,
+                      std::string_view name) const;
+
+  // Incremental updates, called after the ADT has been modified in place so
+  // the index does not need to be rebuilt. Adding a node moves the entries
+  // after it, like a vector insertion.
+  void OnPropertyAdded(const uint8_t *adt, uint32_t node_offset,
+                       uint32_t offset, uint32_t size);
+  void OnPropertyRemoved(const uint8_t *adt, uint32_t node_offset,
+                         uint32_t offset, uint32_t size);
+  void OnNodeAdded(const uint8_t *adt, uint32_t parent_offset,
+                   uint32_t offset, uint32_t size);
+
+  // Matches a node name against a path component with the same semantics as
+  // _adt_nodename_eq: "wlan" matches both "wlan" and "wlan@1000".
+  static bool NodeNameEquals(const char *node_name, size_t node_name_size,
+                             std::string_view name);
+
+private:
+  struct Entry {
+    // Offset before the shifts recorded in m_shifts
+    uint32_t offset;
+    uint32_t parent;
+    uint32_t subtree_size;
+    // Size of the property list
+    uint32_t properties_size;
+    // Offset of the value of the "name" property from the node, or kNone
+    uint32_t name;
+    uint32_t name_size;
+  };
+
+  // Current offset of the node at `index`
+  [[nodiscard]] uint32_t Offset(uint32_t index) const;
+  // One past the last byte of the subtree of the node at `index`
+  [[nodiscard]] uint32_t End(uint32_t index) const;
+  // Shifts the offsets of the nodes from `index` on by `delta`
+  void Shift(uint32_t index, int64_t delta);
+  void FindName(const uint8_t *adt, uint32_t index);
+
+  std::vector<Entry> m_nodes;
+  // Fenwick tree over the nodes, the shift of a node being the sum of the
+  // entries up to it
+  std::vector<int64_t> m_shifts;
+  bool m_shifted = false;
+  // End of the ADT
+  uint32_t m_end = 0;
+};
+
+#endif // ADT_INDEX_H_
@@ -1,14 +1,21 @@
 #ifndef ADT_MODDER_H_
 #define ADT_MODDER_H_
 
+#include <optional>
+#include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "ditto/result.h"
 #include "ditto/span.h"
+#include "extent_list.h"
 
 #include "nlohmann/json.hpp"
 
+class OpPlan;
+struct RunStats;
+
 class AdtModder {
 public:
   enum class Error {
@@ -17,6 +24,10 @@ public:
     NodeNotFound,
     PropertyNotFound,
     NodeAlreadyExists,
+    MalformedAdt,
+    MalformedPatch,
+    PatchMismatch,
+    OutputTooSmall,
   };
 
   static std::string_view error_to_string(Error err) {
@@ -31,29 +42,161 @@ public:
       return "Property not found";
     case Error::NodeAlreadyExists:
       return "Node already exists";
+    case Error::MalformedAdt:
+      return "Malformed ADT";
+    case Error::MalformedPatch:
+      return "Malformed patch";
+    case Error::PatchMismatch:
+      return "Patch does not apply to this ADT";
+    case Error::OutputTooSmall:
+      return "Output buffer too small";
     }
   }
 
   using Adt = std::vector<uint8_t> &;
   using Result = Ditto::Result<void, Error>;
 
-  class Op {
+  enum class Mode {
+    // Structural edits shift the ADT in place as each op runs
+    Immediate,
+    // Structural edits are recorded and the ADT is re-serialized once, after
+    // the last op
+    EditLog,
+    // The ADT is parsed into an arena-backed tree, edited with pointer
+    // operations and serialized once, after the last op
+    Tree,
+  };
+
+  // Byte range of the ADT
+  struct Range {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // Nodes an op applies to
+  struct NodeSelector {
+    // Path or selector (see AdtSelectors) of the nodes
+    std::string node;
+    // If not empty, only the nodes compatible with it
+    std::string compatible;
+  };
+
+  // Node and property an op works on
+  struct Target {
+    std::string_view node;
+    std::string_view property;
+  };
+
+  // Handle to a node of the ADT being modified. Only meaningful to the editor
+  // that returned it.
+  struct Node {
+    uint32_t offset = 0;
+    void *handle = nullptr;
+  };
+
+  // Work done by an editor, for the stats report
+  struct Counters {
+    uint64_t path_lookups = 0;
+    uint64_t property_lookups = 0;
+    // Bytes shifted around inside the ADT buffer by structural edits
+    uint64_t bytes_moved = 0;
+    // Times the ADT buffer had to be reallocated to grow
+    uint64_t reallocations = 0;
+    // Largest size the edited ADT reached
+    uint64_t peak_adt_size = 0;
+  };
+
+  // Primitive operations on an ADT. Ops are written against this interface,
+  // and the mode decides which implementation they run on.
+  class Editor {
   public:
-    virtual Result Run(Adt adt_data, const nlohmann::json &) noexcept = 0;
-    [[nodiscard]] virtual const char *Help() const noexcept {
-      return "No help available for this command";
+    virtual Ditto::Result<Node, Error> FindNode(std::string_view path) = 0;
+    // Pins nodes of the ADT by their position in its index (see AdtIndex),
+    // so FindPinnedNode() finds them whatever their paths resolve to later.
+    // Called before any edit. Looking up a node that was not pinned fails.
+    virtual void PinNodes(Ditto::span<const uint32_t> nodes) = 0;
+    virtual Ditto::Result<Node, Error> FindPinnedNode(uint32_t node) = 0;
+    // Returns the (writable) value of the given property
+    virtual Ditto::Result<Ditto::span<uint8_t>, Error>
+    FindProperty(Node node, std::string_view name) = 0;
+
+    // Adds an empty node at the given path. Its parent must exist.
+    virtual Result AddNode(std::string_view path) = 0;
+    // Appends a property to the property list of the node
+    virtual Result AddProperty(Node node, std::string_view name,
+                               Ditto::span<const uint8_t> value) = 0;
+    virtual Result DeleteProperty(Node node, std::string_view name) = 0;
+
+    // Looks up several properties of a node at once. Missing properties are
+    // left empty. Editors that can should scan the property list only once.
+    virtual void
+    FindProperties(Node node, Ditto::span<const std::string_view> names,
+                   std::vector<std::optional<Ditto::span<uint8_t>>> &values);
+
+    [[nodiscard]] virtual const Counters &GetCounters() const {
+      return m_counters;
     }
 
-    virtual ~Op() = default;
+    virtual ~Editor() = default;
+
+  protected:
+    Counters m_counters;
   };
 
+  explicit AdtModder(Mode mode = Mode::Immediate) : m_mode(mode) {}
+
+  // Whether every op is logged as it runs
+  void SetVerbose(bool verbose) { m_verbose = verbose; }
+  // Collects the stats of the following runs into `stats`, or stops
+  // collecting them if null
+  void SetStats(RunStats *stats) { m_stats = stats; }
+
   Result RunFromJson(Adt adt_data, const nlohmann::json &json) noexcept;
+  Result Run(Adt adt_data, const OpPlan &plan) noexcept;
+  // Runs the ops on `adt` and describes the result as a list of extents of
+  // `adt`, which is left with the modified property values.
+  Ditto::Result<ExtentList, Error> RunToExtents(Ditto::span<uint8_t> adt,
+                                                const OpPlan &plan) noexcept;
+  // Runs a layout-preserving plan directly on `adt`, returning the sorted,
+  // non-overlapping ranges it may have modified.
+  Ditto::Result<std::vector<Range>, Error>
+  RunInPlace(Ditto::span<uint8_t> adt, const OpPlan &plan) noexcept;
+  // Runs the ops on `adt` and writes the result to `out`, whose size is its
+  // capacity. `out` may be `adt` itself, with room to grow, but must not
+  // overlap it otherwise. `size` is set to the size of the result, and
+  // OutputTooSmall is returned if it does not fit. When `out` is `adt`, a
+  // plan failing halfway may leave it partially modified.
+  Result RunToBuffer(Ditto::span<const uint8_t> adt, const OpPlan &plan,
+                     Ditto::span<uint8_t> out, size_t &size) noexcept;
   [[nodiscard]] std::string Help() const noexcept;
 
-  static bool RegisterOperation(std::string_view name, Op &operation) noexcept;
-
+  // Returns the string in the given field of an op, or fails
+  static Ditto::Result<std::string, Error>
+  GetString(const nlohmann::json &command, std::string_view field);
+  // Returns the "node" and "compatible" fields of an op. Ops with only a
+  // "compatible" field apply to every compatible node.
+  static Ditto::Result<NodeSelector, Error>
+  GetNodeSelector(const nlohmann::json &command);
+  // Encodes a property value given as a string or as a typed object, like
+  // add_property takes it
+  static Ditto::Result<std::vector<uint8_t>, Error>
+  EncodeValue(const nlohmann::json &json);
   static Ditto::Result<uint32_t, Error> ParseU32(const std::string &string);
   static Ditto::Result<uint64_t, Error> ParseU64(const std::string &string);
+
+private:
+  Result RunOps(Editor &editor, const OpPlan &plan) noexcept;
+  Result RunSegments(Editor &editor, const OpPlan &plan) noexcept;
+  Result RunOp(Editor &editor, const OpPlan &plan, size_t index) noexcept;
+  // Runs the ops in [begin, end), which all have a target
+  Result RunFused(Editor &editor, const OpPlan &plan, size_t begin,
+                  size_t end) noexcept;
+
+  Mode m_mode;
+  bool m_verbose = true;
+  RunStats *m_stats = nullptr;
+  // Stats of the run in progress, while collecting stats
+  RunStats *m_run = nullptr;
 };
 
 #endif // ADT_MODDER_H_
@@ -0,0 +1,78 @@
+#ifndef ADT_MODDER_C_H_
+#define ADT_MODDER_C_H_
+
+// C interface of the adtmodder library, for programs that run ops in
+// process instead of spawning adt_modder.
+//
+// Plans are compiled once from the json of an op file and can be run any
+// number of times, from any number of threads. Runs read the ADT from a
+// caller buffer and write the result to another caller buffer, without
+// touching the file system. The ADT walkers of adt.h are part of the library
+// as well.
+//
+// Functions return ADT_MODDER_OK or one of the errors below, whose values
+// never change.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum adt_modder_error {
+  ADT_MODDER_OK = 0,
+  ADT_MODDER_ERR_MALFORMED_JSON = 1,
+  ADT_MODDER_ERR_INVALID_OPERATION = 2,
+  ADT_MODDER_ERR_NODE_NOT_FOUND = 3,
+  ADT_MODDER_ERR_PROPERTY_NOT_FOUND = 4,
+  ADT_MODDER_ERR_NODE_ALREADY_EXISTS = 5,
+  ADT_MODDER_ERR_MALFORMED_ADT = 6,
+  ADT_MODDER_ERR_MALFORMED_PATCH = 7,
+  ADT_MODDER_ERR_PATCH_MISMATCH = 8,
+  ADT_MODDER_ERR_OUTPUT_TOO_SMALL = 9,
+};
+
+enum adt_modder_mode {
+  ADT_MODDER_MODE_IMMEDIATE = 0,
+  ADT_MODDER_MODE_EDIT_LOG = 1,
+  ADT_MODDER_MODE_TREE = 2,
+};
+
+struct adt_modder_plan;
+
+// Describes an error, the returned string is static
+const char *adt_modder_strerror(int error);
+
+// Number of supported ops, and the name of each of them. Names are static.
+size_t adt_modder_op_count(void);
+const char *adt_modder_op_name(size_t index);
+
+// Compiles the json text of an op file into `*plan`, which must be released
+// with adt_modder_plan_free()
+int adt_modder_plan_compile(const char *json, size_t json_size,
+                            struct adt_modder_plan **plan);
+void adt_modder_plan_free(struct adt_modder_plan *plan);
+// Sets the seed randomize_property derives its bytes from. Unseeded plans
+// randomize with seed 0.
+void adt_modder_plan_set_seed(struct adt_modder_plan *plan, uint64_t seed);
+// Non-zero if the plan only modifies property values, so its output is as
+// large as its input
+int adt_modder_plan_preserves_layout(const struct adt_modder_plan *plan);
+
+// Runs the plan on the `adt_size` bytes at `adt`, writing the result to
+// `out`, which holds `out_capacity` bytes. `out` may be `adt` itself, with
+// room to grow, but must not overlap it otherwise. `*out_size` is set to the
+// size of the result, and ADT_MODDER_ERR_OUTPUT_TOO_SMALL is returned if it
+// does not fit, so callers can retry with a large enough buffer. When `out`
+// is `adt`, a plan failing halfway may leave it partially modified.
+int adt_modder_run(const struct adt_modder_plan *plan,
+                   enum adt_modder_mode mode, const void *adt,
+                   size_t adt_size, void *out, size_t out_capacity,
+                   size_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADT_MODDER_C_H_
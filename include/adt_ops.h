@@ -0,0 +1,166 @@
+#ifndef ADT_OPS_H_
+#define ADT_OPS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "adt_modder.h"
+#include "nlohmann/json.hpp"
+
+// Every op is a plain record, compiled from its json description before the
+// ADT is touched. Besides its fields, an op provides:
+//  - kName, the name used in the json description,
+//  - kHelp, a description for the help message,
+//  - kPreservesLayout, true if it only ever modifies property values in
+//    place,
+//  - kNeedsProperty, true if it fails on nodes without its property. Nodes
+//    matched by a selector that lack it are skipped instead.
+//  - Compile(), which validates the json and builds the record,
+//  - Run(), which applies it to the ADT without looking at json again,
+//  - GetTarget(), the single property it works on, if it only ever modifies
+//    that property in place. Such ops can be reordered with respect to ops
+//    on other properties.
+//  - Fields(), a tuple of references to its fields, which is how compiled
+//    plans are stored in the plan cache. Fields are strings or byte vectors.
+// Ops on existing nodes take their `node` and `compatible` fields from an
+// AdtModder::NodeSelector.
+// The ops are listed in OpPlan::Op, which is the table used to compile and
+// dispatch them.
+
+struct ReplacePropertyOp {
+  static constexpr std::string_view kName = "replace_property";
+  static constexpr std::string_view kHelp =
+      "Replaces the contents of the property by the given value";
+  static constexpr bool kPreservesLayout = true;
+  static constexpr bool kNeedsProperty = true;
+
+  std::string node;
+  std::string property;
+  std::string value;
+  std::string compatible;
+
+  static Ditto::Result<ReplacePropertyOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return AdtModder::Target{node, property};
+  }
+  auto Fields() { return std::tie(node, property, value, compatible); }
+  auto Fields() const { return std::tie(node, property, value, compatible); }
+};
+
+struct RandomizePropertyOp {
+  static constexpr std::string_view kName = "randomize_property";
+  static constexpr std::string_view kHelp =
+      "Randomizes a property value in the given adt";
+  static constexpr bool kPreservesLayout = true;
+  static constexpr bool kNeedsProperty = true;
+
+  std::string node;
+  std::string property;
+  std::string compatible;
+  // Seed of the run, set through OpPlan::SetSeed(). Not part of the compiled
+  // op. The bytes written only depend on it, the node path and the property
+  // name.
+  uint64_t seed = 0;
+
+  static Ditto::Result<RandomizePropertyOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return AdtModder::Target{node, property};
+  }
+  auto Fields() { return std::tie(node, property, compatible); }
+  auto Fields() const { return std::tie(node, property, compatible); }
+};
+
+struct ZeroOutPropertyOp {
+  static constexpr std::string_view kName = "zero_out_property";
+  static constexpr std::string_view kHelp =
+      "Writes 0's to the given property value";
+  static constexpr bool kPreservesLayout = true;
+  static constexpr bool kNeedsProperty = true;
+
+  std::string node;
+  std::string property;
+  std::string compatible;
+
+  static Ditto::Result<ZeroOutPropertyOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return AdtModder::Target{node, property};
+  }
+  auto Fields() { return std::tie(node, property, compatible); }
+  auto Fields() const { return std::tie(node, property, compatible); }
+};
+
+struct DeletePropertyOp {
+  static constexpr std::string_view kName = "delete_property";
+  static constexpr std::string_view kHelp =
+      "Deletes the given property for the given node in the ADT";
+  static constexpr bool kPreservesLayout = false;
+  static constexpr bool kNeedsProperty = true;
+
+  std::string node;
+  std::string property;
+  std::string compatible;
+
+  static Ditto::Result<DeletePropertyOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return std::nullopt;
+  }
+  auto Fields() { return std::tie(node, property, compatible); }
+  auto Fields() const { return std::tie(node, property, compatible); }
+};
+
+struct AddNodeOp {
+  static constexpr std::string_view kName = "add_node";
+  static constexpr std::string_view kHelp =
+      "Adds the given node to the adt in the specified path. If the parent "
+      "node doesn't exist it fails";
+  static constexpr bool kPreservesLayout = false;
+  static constexpr bool kNeedsProperty = false;
+
+  std::string node;
+
+  static Ditto::Result<AddNodeOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return std::nullopt;
+  }
+  auto Fields() { return std::tie(node); }
+  auto Fields() const { return std::tie(node); }
+};
+
+struct AddPropertyOp {
+  static constexpr std::string_view kName = "add_property";
+  static constexpr std::string_view kHelp =
+      "Adds a new property to the provided node in the ADT";
+  static constexpr bool kPreservesLayout = false;
+  static constexpr bool kNeedsProperty = false;
+
+  std::string node;
+  std::string property;
+  // Encoded value of the property
+  std::vector<uint8_t> value;
+  std::string compatible;
+
+  static Ditto::Result<AddPropertyOp, AdtModder::Error>
+  Compile(const nlohmann::json &command) noexcept;
+  AdtModder::Result Run(AdtModder::Editor &editor) const noexcept;
+  [[nodiscard]] std::optional<AdtModder::Target> GetTarget() const noexcept {
+    return std::nullopt;
+  }
+  auto Fields() { return std::tie(node, property, value, compatible); }
+  auto Fields() const { return std::tie(node, property, value, compatible); }
+};
+
+#endif // ADT_OPS_H_
@@ -0,0 +1,76 @@
+#ifndef ADT_PATCH_H_
+#define ADT_PATCH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "adt_modder.h"
+#include "ditto/result.h"
+#include "ditto/span.h"
+#include "extent_list.h"
+
+// Binary diff between an ADT and its modified version.
+//
+// A patch is a list of records, each replacing a range of the original ADT
+// with new bytes. Records keep the bytes they replace, so every patch can be
+// inverted to turn the modified ADT back into the original. Equal-sized
+// records overwrite bytes in place, while the others insert or delete bytes.
+// The size and hash of the ADT a patch applies to are recorded, and applying
+// it to anything else fails.
+class AdtPatch {
+public:
+  struct Record {
+    // Offset in the ADT the patch applies to
+    uint32_t offset;
+    std::vector<uint8_t> old_bytes;
+    std::vector<uint8_t> new_bytes;
+  };
+
+  // Diffs `original` against the output described by `extents`. `edited` is
+  // the input of the extent list, a copy of `original` that may have been
+  // modified in the ranges the list was given as modified.
+  static AdtPatch Diff(Ditto::span<const uint8_t> original,
+                       Ditto::span<const uint8_t> edited,
+                       const ExtentList &extents);
+
+  // Encodes the patch in its portable binary form
+  [[nodiscard]] std::vector<uint8_t> Serialize() const;
+  // Reads back the output of Serialize(), checking every bound
+  static Ditto::Result<AdtPatch, AdtModder::Error>
+  Deserialize(Ditto::span<const uint8_t> data) noexcept;
+
+  // Returns the patch turning the output of this one back into its input
+  [[nodiscard]] AdtPatch Inverse() const;
+
+  // Returns the patched ADT as extents of `adt`, which must be the ADT the
+  // patch was made for. The extents reference the records, so the patch
+  // must outlive them.
+  [[nodiscard]] Ditto::Result<ExtentList, AdtModder::Error>
+  Apply(Ditto::span<const uint8_t> adt) const noexcept;
+  // Checks that the patch was made for `adt`
+  [[nodiscard]] bool AppliesTo(Ditto::span<const uint8_t> adt) const;
+
+  [[nodiscard]] const std::vector<Record> &Records() const {
+    return m_records;
+  }
+  // True if no record changes the size of the ADT
+  [[nodiscard]] bool PreservesLayout() const;
+
+private:
+  // Appends a record after every other one. Records closer than a record
+  // header to the previous one are merged with it.
+  void Push(Ditto::span<const uint8_t> original, uint32_t offset,
+            size_t old_size, Ditto::span<const uint8_t> new_bytes);
+  // Pushes a record for every run of bytes of `edited` that differ from
+  // the ones at the same offset of `original`
+  void PushChanges(Ditto::span<const uint8_t> original, uint32_t offset,
+                   Ditto::span<const uint8_t> edited);
+
+  std::vector<Record> m_records;
+  uint64_t m_original_size = 0;
+  uint64_t m_original_hash = 0;
+  uint64_t m_result_size = 0;
+  uint64_t m_result_hash = 0;
+};
+
+#endif // ADT_PATCH_H_
@@ -0,0 +1,84 @@
+#ifndef ADT_PATH_CACHE_H_
+#define ADT_PATH_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "adt_index.h"
+
+// Hashed full path -> node offset cache.
+//
+// Paths are normalized (repeated and trailing separators dropped) but
+// otherwise stored as given, so "/arm-io/wlan" and "/arm-io/wlan@0" are cached
+// separately, both resolved with the unit-address matching of the index.
+// Every resolved prefix is cached as well, so the common "/chosen" and
+// "/chosen/secure-boot-hashes" prefixes are only walked once.
+class AdtPathCache {
+public:
+  // Returns the node offset for `path` or a negative ADT_ERR_* code,
+  // resolving any uncached suffix of the path through the index.
+  int Resolve(const AdtIndex &index, const uint8_t *adt,
+              std::string_view path);
+
+  // Records a node that was just added at the given path.
+  void Insert(std::string_view path, uint32_t offset);
+
+  // Keep cached offsets valid after `size` bytes are inserted at or removed
+  // from `offset`.
+  void OnInsert(uint32_t offset, uint32_t size);
+  void OnRemove(uint32_t offset, uint32_t size);
+  // Drops the paths that may resolve differently once the name of the node
+  // at `offset` changes: the ones of its siblings, itself included, and of
+  // their descendants.
+  void OnRename(const AdtIndex &index, uint32_t offset);
+
+  // Pins the node at `offset` under its position in the index. Its offset
+  // is kept valid like the cached ones, but never dropped on renames.
+  void Pin(uint32_t node, uint32_t offset);
+  // Returns the current offset of a pinned node, or AdtIndex::kNone if it
+  // was not pinned
+  [[nodiscard]] uint32_t Pinned(uint32_t node) const;
+
+  void Clear();
+
+  static std::string Normalize(std::string_view path);
+
+private:
+  // Offsets under keys, also kept sorted, so insertions and removals only
+  // shift the offsets after them
+  template <typename Key> class OffsetTable {
+  public:
+    // Returns the offset under `key`, or AdtIndex::kNone
+    [[nodiscard]] uint32_t Find(const Key &key) const;
+    void Set(const Key &key, uint32_t offset);
+
+    void OnInsert(uint32_t offset, uint32_t size);
+    // Offsets inside the removed bytes are dropped
+    void OnRemove(uint32_t offset, uint32_t size);
+    // Drops the offsets strictly between `begin` and `end`
+    void Drop(uint32_t begin, uint32_t end);
+
+    void Clear();
+
+  private:
+    // Position in m_order of the first offset not below `offset`
+    [[nodiscard]] size_t LowerBound(uint32_t offset) const;
+    void Free(size_t begin, size_t end);
+
+    // Every key lives in a slot, reused once its key is dropped
+    std::unordered_map<Key, uint32_t> m_slots;
+    std::vector<Key> m_keys;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_free;
+    // Used slots, sorted by offset
+    std::vector<uint32_t> m_order;
+  };
+
+  OffsetTable<std::string> m_offsets;
+  OffsetTable<uint32_t> m_pinned;
+};
+
+#endif // ADT_PATH_CACHE_H_
@@ -0,0 +1,74 @@
+#ifndef ADT_PROPERTY_INDEX_H_
+#define ADT_PROPERTY_INDEX_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "adt_index.h"
+
+// Per-node property name -> offset hash tables.
+//
+// The table of a node is built the first time one of its properties is looked
+// up, with a single scan of its property list, so workloads that touch many
+// properties of the same node pay one scan per node instead of one per lookup.
+// Nodes with only a few properties are always scanned instead.
+//
+// Tables are open-addressed with linear probing and store offsets relative to
+// their node, so they stay valid when other nodes move. Edits to the property
+// list of a node are applied to its table incrementally. Tables are kept in
+// the pre-order of the AdtIndex the lookups are made with, which must be kept
+// up to date before calling the On*() hooks.
+class AdtPropertyIndex {
+public:
+  // Nodes with fewer properties than this are not indexed
+  static constexpr uint32_t kMinProperties = 8;
+
+  // Returns the offset of the first property of the node named `name`, with
+  // the semantics of adt_get_property_namelen, or -ADT_ERR_NOTFOUND.
+  int Find(const AdtIndex &index, const uint8_t *adt, uint32_t node_offset,
+           std::string_view name);
+
+  // Incremental updates, called after the ADT and `index` have been modified
+  void OnPropertyAdded(const AdtIndex &index, const uint8_t *adt,
+                       uint32_t node_offset, uint32_t offset, uint32_t size);
+  // `name` is the name of the removed property, which must have been the
+  // first one with that name
+  void OnPropertyRemoved(const AdtIndex &index, uint32_t node_offset,
+                         std::string_view name, uint32_t offset,
+                         uint32_t size);
+  void OnNodeAdded(const AdtIndex &index, uint32_t offset);
+
+private:
+  struct Slot {
+    uint32_t hash;
+    // Offset of the property from the start of its node, 0 if the slot is
+    // empty
+    uint32_t offset;
+  };
+
+  struct Table {
+    std::vector<Slot> slots;
+    uint32_t count = 0;
+    // Set if the node has several properties with the same name. Only the
+    // first one is in the table.
+    bool has_duplicates = false;
+
+    [[nodiscard]] bool IsBuilt() const { return !slots.empty(); }
+  };
+
+  static uint32_t Hash(std::string_view name);
+  static std::string_view PropertyName(const uint8_t *adt, uint32_t offset);
+
+  Table *TableFor(const AdtIndex &index, uint32_t node_offset);
+  static void Build(const uint8_t *adt, uint32_t node_offset, Table &table);
+  // Returns the slot of the property named `name`, or the empty slot where it
+  // would go
+  static Slot &Probe(const uint8_t *adt, uint32_t node_offset, Table &table,
+                     std::string_view name, uint32_t hash);
+  static void Erase(Table &table, Slot &slot);
+
+  std::vector<Table> m_tables;
+};
+
+#endif // ADT_PROPERTY_INDEX_H_
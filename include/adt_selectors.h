@@ -0,0 +1,61 @@
+#ifndef ADT_SELECTORS_H_
+#define ADT_SELECTORS_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "adt_index.h"
+
+// Node paths with wildcards, all matched against an ADT in a single
+// depth-first walk.
+//
+// A `*` in a path component matches any run of characters of a node name, so
+// "/arm-io/*" matches every child of arm-io and "/arm-io/uart@*" every uart
+// with a unit address. A component that is just `**` matches any number of
+// nodes, including none. Components without wildcards match like they do in
+// adt_path_offset(), so "wlan" also matches "wlan@1000".
+class AdtSelectors {
+public:
+  // A node matched by a selector
+  struct Hit {
+    // Path of the node, made of the full names of its ancestors
+    std::string path;
+    uint32_t offset;
+  };
+
+  // True if `path` is a selector rather than a plain node path
+  static bool IsPattern(std::string_view path) {
+    return path.find('*') != std::string_view::npos;
+  }
+
+  // Adds a selector, returning its index in the result of Match()
+  size_t Add(std::string_view selector);
+
+  // Returns the nodes matched by every selector, in the order they appear in
+  // the ADT, walking `index` once. Subtrees no selector can match in are
+  // skipped.
+  [[nodiscard]] std::vector<std::vector<Hit>>
+  Match(const uint8_t *adt, const AdtIndex &index) const;
+
+private:
+  // How far a selector got: its first `component` components matched the
+  // path of a node
+  struct State {
+    uint32_t selector;
+    uint32_t component;
+
+    bool operator==(const State &) const = default;
+  };
+
+  // Adds `state` to `states`, followed by the states the `**` components
+  // after it let it skip to
+  void AddState(std::vector<State> &states, State state) const;
+  static bool ComponentMatches(std::string_view pattern,
+                               std::string_view name, size_t name_size);
+
+  std::vector<std::vector<std::string>> m_selectors;
+};
+
+#endif // ADT_SELECTORS_H_
@@ -0,0 +1,88 @@
+#ifndef ADT_SERVER_H_
+#define ADT_SERVER_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "adt_modder.h"
+#include "ditto/result.h"
+#include "fileio.h"
+#include "nlohmann/json.hpp"
+#include "op_plan.h"
+
+// Serves op runs over a Unix domain socket, keeping the base ADTs and the
+// compiled plans it was asked for in memory.
+//
+// Clients send one json request per line, and get a json response line for
+// each. Requests name a base ADT and an op file by path:
+//
+//   {"adt": "base.bin", "ops": "ops.json", "seed": 1, "patch": false,
+//    "output": "out.bin"}
+//
+// "seed", "patch" and "output" are optional. The result is written to
+// "output" when given, and the response is {"ok": true}. Otherwise the
+// response is {"ok": true, "size": N}, followed by the N bytes of the result.
+// Randomizing runs without a seed get a random one, returned as "seed".
+// Failed requests get {"ok": false, "error": "..."}.
+//
+// Base ADTs and plans are loaded on first use, and loaded again when their
+// file changes. Past a few dozen of each, the least recently used one is
+// dropped.
+class AdtServer {
+public:
+  explicit AdtServer(AdtModder::Mode mode) : m_mode(mode) {}
+
+  // Listens on `socket_path`, replacing any file there, and serves clients
+  // until an error occurs. Connections are watched from the calling thread,
+  // and the requests they send run on `workers` threads, so clients only
+  // hold a thread while one of their requests runs.
+  Ditto::Result<void, std::string> Serve(const std::string &socket_path,
+                                         size_t workers);
+
+private:
+  // A loaded file, with the modification time it was loaded at
+  template <typename T> struct Loaded {
+    std::filesystem::file_time_type modified;
+    std::shared_ptr<const T> value;
+    // Value of m_uses when it was last used
+    uint64_t last_used = 0;
+  };
+
+  // A connected client. Owned by the thread watching connections while it
+  // is idle, and by the worker running its requests otherwise.
+  struct Client {
+    int fd;
+    File file;
+    // Bytes received after the last complete request
+    std::string pending;
+  };
+
+  // Runs the complete requests received from `client`. Returns false if it
+  // went away or sent something that is not a request.
+  bool ServeRequests(Client &client);
+  // Runs a request, writing its response to `client`. Returns false if the
+  // client went away.
+  bool HandleRequest(File &client, std::string_view line);
+  Ditto::Result<void, std::string> RunRequest(File &client,
+                                              const nlohmann::json &request,
+                                              nlohmann::json &response);
+
+  Ditto::Result<std::shared_ptr<const std::vector<uint8_t>>, std::string>
+  GetAdt(const std::string &path);
+  Ditto::Result<std::shared_ptr<const OpPlan>, std::string>
+  GetPlan(const std::string &path);
+
+  AdtModder::Mode m_mode;
+  std::mutex m_mutex;
+  std::unordered_map<std::string, Loaded<std::vector<uint8_t>>> m_adts;
+  std::unordered_map<std::string, Loaded<OpPlan>> m_plans;
+  // Loaded files used so far, counting every use
+  uint64_t m_uses = 0;
+};
+
+#endif // ADT_SERVER_H_
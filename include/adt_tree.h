@@ -0,0 +1,84 @@
+#ifndef ADT_TREE_H_
+#define ADT_TREE_H_
+
+#include <cstdint>
+#include <string_view>
+
+#include "adt_index.h"
+#include "arena.h"
+#include "ditto/result.h"
+#include "ditto/span.h"
+
+// Parsed representation of an ADT.
+//
+// Nodes and properties are allocated from an arena and linked with plain
+// pointers, so structural edits never move any data around. Names and values
+// of the properties that were parsed keep pointing into the original buffer,
+// which must outlive the tree; only added properties are copied into the
+// arena. The wire format is produced once, by Serialize().
+class AdtTree {
+public:
+  struct Property {
+    Property *next;
+    // NUL-padded name field, sizeof(adt_property::name) bytes long
+    const char *name;
+    Ditto::span<uint8_t> value;
+    // Bits of the size field above the size of the value, written back as
+    // they were parsed
+    uint32_t flags = 0;
+
+    [[nodiscard]] std::string_view Name() const;
+    // Size of the property in the wire format, padding included
+    [[nodiscard]] size_t Size() const;
+  };
+
+  struct Node {
+    Node *parent;
+    Node *first_child;
+    Node *last_child;
+    Node *next_sibling;
+    Property *first_property;
+    Property *last_property;
+    // The first "name" property of the node, if any
+    Property *name;
+    uint32_t property_count;
+    uint32_t child_count;
+  };
+
+  // Creates a tree holding an empty root node
+  AdtTree();
+
+  static Ditto::Result<AdtTree, AdtIndex::Error>
+  Parse(Ditto::span<uint8_t> adt);
+
+  [[nodiscard]] Node *Root() const { return m_root; }
+  // Size of the serialized tree
+  [[nodiscard]] size_t Size() const { return m_size; }
+
+  // Lookups follow the adt.c semantics: the first match wins, and "wlan"
+  // matches a node named "wlan@1000".
+  static Node *FindChild(const Node *parent, std::string_view name);
+  static Property *FindProperty(const Node *node, std::string_view name);
+
+  // Appends a child holding only a "name" property
+  Node *AddChild(Node *parent, std::string_view name);
+  // Appends a property, copying its value into the arena
+  Property *AddProperty(Node *node, std::string_view name,
+                        Ditto::span<const uint8_t> value);
+  void DeleteProperty(Node *node, Property *property);
+
+  // Writes the tree to `out`, which must be Size() bytes long
+  void Serialize(Ditto::span<uint8_t> out) const;
+
+private:
+  explicit AdtTree(Arena arena);
+
+  Node *NewNode(Node *parent);
+  void LinkProperty(Node *node, Property *property);
+
+  Arena m_arena;
+  Node *m_root;
+  size_t m_size;
+};
+
+#endif // ADT_TREE_H_
@@ -0,0 +1,54 @@
+#ifndef ADT_TREE_EDITOR_H_
+#define ADT_TREE_EDITOR_H_
+
+#include <string>
+#include <unordered_map>
+
+#include "adt_modder.h"
+#include "adt_tree.h"
+
+// Editor that parses the ADT into an AdtTree, so structural edits are pointer
+// operations. Nodes never move, so resolved paths stay valid until a node is
+// renamed.
+class AdtTreeEditor : public AdtModder::Editor {
+public:
+  static Ditto::Result<AdtTreeEditor, AdtModder::Error>
+  Create(Ditto::span<uint8_t> adt) noexcept;
+
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindNode(std::string_view path) override;
+  void PinNodes(Ditto::span<const uint32_t> nodes) override;
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindPinnedNode(uint32_t node) override;
+  Ditto::Result<Ditto::span<uint8_t>, AdtModder::Error>
+  FindProperty(AdtModder::Node node, std::string_view name) override;
+
+  AdtModder::Result AddNode(std::string_view path) override;
+  AdtModder::Result AddProperty(AdtModder::Node node, std::string_view name,
+                                Ditto::span<const uint8_t> value) override;
+  AdtModder::Result DeleteProperty(AdtModder::Node node,
+                                   std::string_view name) override;
+
+  [[nodiscard]] const AdtTree &Tree() const { return m_tree; }
+
+private:
+  explicit AdtTreeEditor(AdtTree tree) : m_tree(std::move(tree)) {
+    m_counters.peak_adt_size = m_tree.Size();
+  }
+
+  static AdtTree::Node *TreeNode(AdtModder::Node node) {
+    return static_cast<AdtTree::Node *>(node.handle);
+  }
+
+  AdtTree::Node *ResolveNode(std::string_view path);
+  // Forgets the paths that may resolve differently once `node` is renamed:
+  // the ones of its siblings, itself included, and of their descendants
+  void OnRename(const AdtTree::Node *node);
+
+  AdtTree m_tree;
+  std::unordered_map<std::string, AdtTree::Node *> m_paths;
+  // Pinned nodes, by their position in the index of the parsed ADT
+  std::unordered_map<uint32_t, AdtTree::Node *> m_pinned;
+};
+
+#endif // ADT_TREE_EDITOR_H_
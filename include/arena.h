@@ -0,0 +1,56 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator. Memory is handed out from large chunks and only released
+// when the arena itself goes away, so objects allocated from it are never
+// destroyed individually and must be trivially destructible. Pointers into
+// the arena stay valid when the arena is moved.
+class Arena {
+public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit Arena(size_t chunk_size = kDefaultChunkSize)
+      : m_chunk_size(chunk_size) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  Arena(Arena &&other) noexcept
+      : m_chunks(std::move(other.m_chunks)),
+        m_cursor(std::exchange(other.m_cursor, nullptr)),
+        m_remaining(std::exchange(other.m_remaining, 0)),
+        m_chunk_size(other.m_chunk_size) {}
+  Arena &operator=(Arena &&other) noexcept {
+    m_chunks = std::move(other.m_chunks);
+    m_cursor = std::exchange(other.m_cursor, nullptr);
+    m_remaining = std::exchange(other.m_remaining, 0);
+    m_chunk_size = other.m_chunk_size;
+    return *this;
+  }
+
+  ~Arena() = default;
+
+  void *Allocate(size_t size, size_t alignment);
+
+  template <typename T, typename... Args> T *New(Args &&...args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Objects in the arena are never destroyed");
+    return new (Allocate(sizeof(T), alignof(T)))
+        T{std::forward<Args>(args)...};
+  }
+
+private:
+  std::vector<std::unique_ptr<uint8_t[]>> m_chunks;
+  uint8_t *m_cursor = nullptr;
+  size_t m_remaining = 0;
+  size_t m_chunk_size;
+};
+
+#endif // ARENA_H_
@@ -0,0 +1,66 @@
+#ifndef EXTENT_LIST_H_
+#define EXTENT_LIST_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "ditto/span.h"
+
+// Describes an output file as a sequence of extents, each one either a range
+// of the input or a block of new bytes. Ranges of the input that were not
+// modified in memory remember their input offset, so the writer can have the
+// kernel copy them straight from the input file.
+class ExtentList {
+public:
+  static constexpr size_t kNotInInput = SIZE_MAX;
+
+  struct Extent {
+    const uint8_t *data;
+    size_t size;
+    // Offset of the data in the input file, or kNotInInput if the bytes only
+    // exist in memory
+    size_t input_offset;
+  };
+
+  struct Range {
+    size_t offset;
+    size_t size;
+  };
+
+  // `input` is the input as loaded in memory, which must outlive the list.
+  // `modified` holds the sorted, non-overlapping ranges of `input` that may
+  // differ from the input file.
+  ExtentList(Ditto::span<const uint8_t> input, std::vector<Range> modified)
+      : m_input(input), m_modified(std::move(modified)) {}
+
+  // Appends a range of the input
+  void AddInput(size_t offset, size_t size);
+  // Appends bytes owned by the caller, which must outlive the list
+  void AddBuffer(Ditto::span<const uint8_t> buffer);
+  // Appends bytes owned by the list
+  void AddBuffer(std::vector<uint8_t> buffer);
+  // Appends `size` uninitialized bytes owned by the list, returning them to
+  // be filled in
+  uint8_t *AddBytes(size_t size);
+
+  [[nodiscard]] const std::vector<Extent> &Extents() const {
+    return m_extents;
+  }
+  [[nodiscard]] size_t Size() const { return m_size; }
+
+  // Copies every extent to `out`, which must be Size() bytes long
+  void CopyTo(Ditto::span<uint8_t> out) const;
+
+private:
+  void Append(const uint8_t *data, size_t size, size_t input_offset);
+
+  Ditto::span<const uint8_t> m_input;
+  std::vector<Range> m_modified;
+  std::vector<Extent> m_extents;
+  std::vector<std::vector<uint8_t>> m_buffers;
+  Arena m_arena;
+  size_t m_size = 0;
+};
+
+#endif // EXTENT_LIST_H_
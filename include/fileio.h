@@ -2,10 +2,15 @@
 #define FILEIO_H_
 
 #include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "ditto/result.h"
 #include "ditto/span.h"
+#include "extent_list.h"
+
+struct iovec;
 
 class File {
 public:
@@ -17,11 +22,83 @@ public:
     InvalidPermissions,
   };
 
+  static std::string_view error_to_string(Error err) {
+    switch (err) {
+    case Error::Unknown:
+      return "Unknown error";
+    case Error::IoError:
+      return "I/O error";
+    case Error::FileAlreadyExists:
+      return "File already exists";
+    case Error::FileDoesNotExist:
+      return "File does not exist";
+    case Error::InvalidPermissions:
+      return "Invalid permissions";
+    }
+    return "Unknown error";
+  }
+
+  enum class MapMode {
+    ReadOnly,
+    // Writable, but writes are copy-on-write and never reach the file
+    Private,
+    // Writable, writes go to the file. Requires a file opened for writing.
+    Shared,
+  };
+
+  // A memory mapping of the whole file, unmapped when destroyed
+  class Mapping {
+  public:
+    [[nodiscard]] Ditto::span<uint8_t> Data() const {
+      return {static_cast<uint8_t *>(m_address), m_size};
+    }
+
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    Mapping(Mapping &&);
+    Mapping &operator=(Mapping &&);
+
+    ~Mapping();
+
+  private:
+    friend class File;
+
+    Mapping(void *address, size_t size) : m_address(address), m_size(size) {}
+
+    void *m_address = nullptr;
+    size_t m_size = 0;
+  };
+
+  // Unchanged input ranges at least this large are copied by the kernel
+  static constexpr size_t kCopyThreshold = 64 * 1024;
+
   static Ditto::Result<File, Error> Create(const char *name);
+  // Creates a uniquely named file next to `path`, meant to be renamed over it
+  // once it is complete. Its name is returned in `temp_path`.
+  static Ditto::Result<File, Error> CreateTemporary(const std::string &path,
+                                                    std::string &temp_path);
   static Ditto::Result<File, Error> Open(const char *name);
+  static Ditto::Result<File, Error> OpenReadWrite(const char *name);
+  // Takes ownership of an open descriptor, such as a socket
+  static File FromDescriptor(int fd) { return File{fd}; }
+
+  static Ditto::Result<void, Error> Rename(const std::string &from,
+                                           const std::string &to);
+  static void Remove(const std::string &path);
 
   Ditto::Result<std::vector<uint8_t>, Error> ReadAll();
+  // Reads whatever is available, up to the size of `buffer`. Returns 0 at
+  // the end of the file.
+  Ditto::Result<size_t, Error> ReadSome(Ditto::span<uint8_t> buffer);
+  Ditto::Result<Mapping, Error> Map(MapMode mode) const;
   Ditto::Result<void, Error> Write(Ditto::span<uint8_t> buffer);
+  Ditto::Result<void, Error> WriteAt(size_t offset,
+                                     Ditto::span<const uint8_t> buffer);
+  // Writes every extent in order. Unchanged ranges of `input`, when given,
+  // may be copied from file to file by the kernel.
+  Ditto::Result<void, Error> WriteExtents(const ExtentList &extents,
+                                          const File *input);
 
   Ditto::Result<size_t, Error> SetOffset(size_t offset);
 
@@ -40,6 +117,10 @@ private:
 
   File(int fd) : m_fd(fd) {}
 
+  Ditto::Result<void, Error> WriteVector(struct iovec *iov, int count);
+  // Appends a range of `input`, returning how many bytes were copied
+  size_t CopyRange(const File &input, size_t offset, size_t size);
+
   static File::Error ErrorFromErrno(int error_var);
 };
 
@@ -0,0 +1,90 @@
+#ifndef OP_PLAN_H_
+#define OP_PLAN_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "adt_modder.h"
+#include "adt_ops.h"
+#include "nlohmann/json.hpp"
+
+// A list of ops compiled from json into typed records.
+//
+// The whole list is validated when it is compiled, so a malformed file fails
+// before any byte of the ADT is written, and running the plan never looks at
+// json again.
+class OpPlan {
+public:
+  // Table of every supported op. Ops are looked up by name in this order.
+  using Op = std::variant<ReplacePropertyOp, RandomizePropertyOp,
+                          ZeroOutPropertyOp, DeletePropertyOp, AddNodeOp,
+                          AddPropertyOp>;
+
+  static Ditto::Result<OpPlan, AdtModder::Error>
+  Compile(const nlohmann::json &op_array) noexcept;
+  // Parses and compiles the text of a json op file
+  static Ditto::Result<OpPlan, AdtModder::Error>
+  Parse(Ditto::span<const uint8_t> json_text) noexcept;
+
+  // Encodes the compiled ops in a compact binary form, with every value
+  // already encoded. Only meant to be read back by the same build.
+  [[nodiscard]] std::vector<uint8_t> Serialize() const;
+  // Reads back the output of Serialize(). The data is fully bounds-checked,
+  // so a corrupt buffer is reported as MalformedJson rather than trusted.
+  static Ditto::Result<OpPlan, AdtModder::Error>
+  Deserialize(Ditto::span<const uint8_t> data) noexcept;
+
+  [[nodiscard]] const std::vector<Op> &Ops() const { return m_ops; }
+  // True if every op only modifies property values in place
+  [[nodiscard]] bool PreservesLayout() const { return m_preserves_layout; }
+  // True if the node of any op is a selector (see AdtSelectors)
+  [[nodiscard]] bool HasSelectors() const { return m_has_selectors; }
+
+  // Returns a copy of the plan where every op with a selector is replaced by
+  // a copy of it for each node of `adt` it matches, in the order they appear
+  // in the ADT. Every selector is matched in the same walk of the ADT, before
+  // any op runs, so nodes added by the plan are never matched. Selectors
+  // matching no node fail with NodeNotFound.
+  //
+  // The copies are pinned to the node they matched (see Pins()), since their
+  // path may resolve to another node: "/bus/uart" names the first of
+  // "uart@5" and "uart".
+  [[nodiscard]] Ditto::Result<OpPlan, AdtModder::Error>
+  Expand(Ditto::span<uint8_t> adt) const noexcept;
+  // For every op of an expanded plan, the position in the index of the ADT
+  // of the node it is pinned to, or AdtIndex::kNone. Empty for plans that
+  // were not expanded.
+  [[nodiscard]] const std::vector<uint32_t> &Pins() const { return m_pins; }
+
+  static std::string_view Name(const Op &op) noexcept;
+  static std::optional<AdtModder::Target> GetTarget(const Op &op) noexcept;
+  static AdtModder::Result Run(const Op &op,
+                               AdtModder::Editor &editor) noexcept;
+
+  // Sets the seed randomizing ops derive their bytes from. Plans that are
+  // never seeded randomize with seed 0.
+  void SetSeed(uint64_t seed);
+  [[nodiscard]] std::optional<uint64_t> Seed() const { return m_seed; }
+  // True if running the plan writes random bytes
+  [[nodiscard]] bool IsRandomized() const;
+
+  // Lists every supported op
+  static std::string Help() noexcept;
+  // Names of every supported op, in table order
+  static std::vector<std::string_view> Names() noexcept;
+
+private:
+  void Append(Op op);
+
+  std::vector<Op> m_ops;
+  std::vector<uint32_t> m_pins;
+  bool m_preserves_layout = true;
+  bool m_has_selectors = false;
+  std::optional<uint64_t> m_seed;
+};
+
+#endif // OP_PLAN_H_
@@ -0,0 +1,66 @@
+#ifndef PHILOX_H_
+#define PHILOX_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "ditto/span.h"
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3").
+//
+// Every 16-byte block of output is a pure function of the key and the block
+// index, so a buffer can be filled in any order, or split between threads,
+// and always gets the same bytes for the same key.
+class Philox {
+public:
+  explicit Philox(uint64_t key)
+      : m_key{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)} {}
+
+  // Fills `out` with the stream starting at block 0
+  void Fill(Ditto::span<uint8_t> out) const {
+    uint8_t *data = out.data();
+    const size_t blocks = out.size() / kBlockSize;
+    for (size_t i = 0; i < blocks; i++) {
+      const auto block = Block(i);
+      memcpy(data + i * kBlockSize, block.data(), kBlockSize);
+    }
+
+    const size_t tail = out.size() % kBlockSize;
+    if (tail != 0) {
+      const auto block = Block(blocks);
+      memcpy(data + blocks * kBlockSize, block.data(), tail);
+    }
+  }
+
+  // Output block `index` of the stream
+  [[nodiscard]] std::array<uint32_t, 4> Block(uint64_t index) const {
+    std::array<uint32_t, 4> ctr{static_cast<uint32_t>(index),
+                                static_cast<uint32_t>(index >> 32), 0, 0};
+    std::array<uint32_t, 2> key = m_key;
+    for (int round = 0; round < kRounds; round++) {
+      const uint64_t product0 = uint64_t{kMultiplier0} * ctr[0];
+      const uint64_t product1 = uint64_t{kMultiplier1} * ctr[2];
+      ctr = {static_cast<uint32_t>(product1 >> 32) ^ ctr[1] ^ key[0],
+             static_cast<uint32_t>(product1),
+             static_cast<uint32_t>(product0 >> 32) ^ ctr[3] ^ key[1],
+             static_cast<uint32_t>(product0)};
+      key[0] += kWeyl0;
+      key[1] += kWeyl1;
+    }
+    return ctr;
+  }
+
+private:
+  static constexpr size_t kBlockSize = 4 * sizeof(uint32_t);
+  static constexpr int kRounds = 10;
+  static constexpr uint32_t kMultiplier0 = 0xD2511F53;
+  static constexpr uint32_t kMultiplier1 = 0xCD9E8D57;
+  static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+  static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+
+  std::array<uint32_t, 2> m_key;
+};
+
+#endif // PHILOX_H_
@@ -0,0 +1,50 @@
+#ifndef PLAN_CACHE_H_
+#define PLAN_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "adt_modder.h"
+#include "ditto/result.h"
+#include "ditto/span.h"
+#include "op_plan.h"
+
+// On-disk cache of compiled op plans.
+//
+// Plans are stored in their binary form, in a file named after a hash of the
+// json they were compiled from. Looking up a cached plan maps that file and
+// decodes it, without parsing any json. Anything wrong with a cache entry is
+// treated as a miss, and failing to store an entry is not an error.
+class PlanCache {
+public:
+  // $ADT_MODDER_CACHE_DIR, $XDG_CACHE_HOME/adt_modder or
+  // $HOME/.cache/adt_modder, whichever is set first
+  static std::optional<std::string> DefaultDirectory();
+
+  explicit PlanCache(std::string directory)
+      : m_directory(std::move(directory)) {}
+
+  // Returns the plan compiled from the given json text, compiling and
+  // storing it on a cache miss
+  Ditto::Result<OpPlan, AdtModder::Error>
+  Get(Ditto::span<const uint8_t> json_text);
+
+private:
+  // Cache entries start with the size and hash of the json they were compiled
+  // from, followed by the serialized plan
+  struct EntryHeader {
+    uint64_t json_size;
+    uint64_t json_hash;
+  };
+
+  [[nodiscard]] std::string EntryPath(uint64_t json_hash) const;
+  std::optional<OpPlan> Load(const std::string &path,
+                             const EntryHeader &expected) const;
+  void Store(const std::string &path, const EntryHeader &header,
+             const OpPlan &plan) const;
+
+  std::string m_directory;
+};
+
+#endif // PLAN_CACHE_H_
@@ -0,0 +1,43 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "ditto/span.h"
+#include "op_plan.h"
+#include "utils.h"
+
+// On-disk cache of the outputs of an op plan.
+//
+// Entries are named after 128-bit hashes of the input ADT and of the plan,
+// and the size of the input, so a hit only costs hashing the input. Outputs
+// are always copies of the entry, never links to it, so writing to an output
+// in place later can't corrupt the cache. Failing to store an entry is not an
+// error.
+class ResultCache {
+public:
+  // `plan_hash` identifies the plan and the format of its outputs, see
+  // PlanHash()
+  ResultCache(std::string directory, utils::Hash128 plan_hash)
+      : m_directory(std::move(directory)), m_plan_hash(plan_hash) {}
+
+  // Hashes the ops of the plan and its seed, if it has randomizing ops.
+  // `variant` tells apart different kinds of outputs of the same plan.
+  static utils::Hash128 PlanHash(const OpPlan &plan, std::string_view variant);
+
+  // Path of the entry holding the output for `input`
+  [[nodiscard]] std::string EntryPath(Ditto::span<const uint8_t> input) const;
+
+  // Makes `dest` the output held by the entry, returning false on a miss
+  static bool Fetch(const std::string &entry, const std::string &dest);
+  // Stores a copy of `output` as the entry
+  void Store(const std::string &entry, const std::string &output) const;
+
+private:
+  std::string m_directory;
+  utils::Hash128 m_plan_hash;
+};
+
+#endif // RESULT_CACHE_H_
@@ -0,0 +1,39 @@
+#ifndef RUN_STATS_H_
+#define RUN_STATS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "adt_modder.h"
+#include "nlohmann/json.hpp"
+
+// Stats of running an op plan on one or more ADTs, as reported by --stats.
+//
+// Every op gets the work its editor did while it ran. Lookups of ops that ran
+// fused are done up front for the whole group, so they only show up in the
+// totals.
+struct RunStats {
+  struct Op {
+    std::string name;
+    std::string node;
+    bool fused = false;
+    // Number of runs the op failed in
+    uint64_t failures = 0;
+    uint64_t wall_ns = 0;
+    AdtModder::Counters counters;
+  };
+
+  std::vector<Op> ops;
+  // Number of ADTs the plan ran on
+  uint64_t runs = 0;
+  uint64_t wall_ns = 0;
+  AdtModder::Counters totals;
+
+  // Adds the stats of another run of the same plan
+  void Merge(const RunStats &other);
+
+  [[nodiscard]] nlohmann::json ToJson() const;
+};
+
+#endif // RUN_STATS_H_
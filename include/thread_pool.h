@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+//
+// Every worker owns a queue. Submitted tasks are spread over the queues, a
+// worker pops tasks from the back of its own queue and, once it runs dry,
+// steals from the front of the others. Tasks receive the index of the worker
+// running them, so callers can keep per-worker state without locking.
+class ThreadPool {
+public:
+  using Task = std::function<void(size_t worker)>;
+
+  // Zero workers means one per hardware thread
+  explicit ThreadPool(size_t workers = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  [[nodiscard]] size_t Workers() const { return m_queues.size(); }
+
+  void Submit(Task task);
+  // Blocks until every submitted task has run
+  void Wait();
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void Run(size_t worker);
+  bool Pop(size_t worker, Task &task);
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_work_available;
+  std::condition_variable m_idle;
+  // Tasks submitted but not finished yet
+  size_t m_pending = 0;
+  // Tasks sitting in a queue
+  std::atomic<size_t> m_queued = 0;
+  size_t m_next_queue = 0;
+  bool m_stopping = false;
+};
+
+#endif // THREAD_POOL_H_
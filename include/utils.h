@@ -1,7 +1,9 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace utils {
 
@@ -9,6 +11,104 @@ inline size_t roundUpToAlignment(const size_t value, size_t alignment) {
   return (value + alignment - 1) & ~(alignment - 1);
 }
 
+// 64-bit FNV-1a hash of a byte buffer
+inline uint64_t hashBytes(const uint8_t *data, size_t size,
+                          uint64_t hash = 0xcbf29ce484222325) {
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+struct Hash128 {
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(const Hash128 &) const = default;
+};
+
+namespace detail {
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccd;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53;
+  k ^= k >> 33;
+  return k;
+}
+
+} // namespace detail
+
+// 128-bit MurmurHash3 (x64 variant) of a byte buffer. Reads 16 bytes at a
+// time, for keys where a 64-bit hash is too likely to collide.
+inline Hash128 hash128(const uint8_t *data, size_t size, uint64_t seed = 0) {
+  constexpr uint64_t c1 = 0x87c37b91114253d5;
+  constexpr uint64_t c2 = 0x4cf5ad432745937f;
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  const size_t blocks = size / 16;
+  for (size_t i = 0; i < blocks; i++) {
+    uint64_t k1;
+    uint64_t k2;
+    memcpy(&k1, data + i * 16, sizeof(k1));
+    memcpy(&k2, data + i * 16 + 8, sizeof(k2));
+
+    k1 *= c1;
+    k1 = detail::rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = detail::rotl64(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = detail::rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = detail::rotl64(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  // The last 0 to 15 bytes, little-endian
+  const uint8_t *tail = data + blocks * 16;
+  const size_t left = size % 16;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (size_t i = left; i > 8; i--) {
+    k2 = k2 << 8 | tail[i - 1];
+  }
+  for (size_t i = left < 8 ? left : 8; i > 0; i--) {
+    k1 = k1 << 8 | tail[i - 1];
+  }
+  if (left > 8) {
+    k2 *= c2;
+    k2 = detail::rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  if (left > 0) {
+    k1 *= c1;
+    k1 = detail::rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = detail::fmix64(h1);
+  h2 = detail::fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  return {h1, h2};
+}
+
 } // namespace utils
 
 #endif // UTILS_H_
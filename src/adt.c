@@ -52,6 +52,69 @@ int _adt_check_prop_offset(void *adt, int offset) {
 
 int adt_check_header(void *adt) { return _adt_check_node_offset(adt, 0); }
 
+/*
+ * Nodes are laid out in pre-order, so the number of nodes still to be read is
+ * enough to know when the tree ends: every node read takes one off and adds
+ * its children.
+ */
+int adt_validate(const void *adt, size_t size) {
+  const u8 *data = adt;
+  size_t offset = 0;
+  size_t pending = 1;
+
+  if (size > INT32_MAX)
+    return -ADT_ERR_BADLENGTH;
+
+  while (pending--) {
+    if (offset % ADT_ALIGN || size - offset < sizeof(struct adt_node_hdr))
+      return -ADT_ERR_BADOFFSET;
+
+    const struct adt_node_hdr *node = (const void *)(data + offset);
+    if (node->property_count > 2048 || node->child_count > 2048 ||
+        (offset == 0 && !node->property_count))
+      return -ADT_ERR_BADOFFSET;
+
+    const u32 property_count = node->property_count;
+    pending += node->child_count;
+    offset += sizeof(struct adt_node_hdr);
+
+    int has_name = 0;
+    for (u32 i = 0; i < property_count; i++) {
+      if (size - offset < sizeof(struct adt_property))
+        return -ADT_ERR_BADOFFSET;
+
+      const struct adt_property *prop = (const void *)(data + offset);
+      /* The top bit of the size is a flag, not part of the size */
+      const size_t value_size = ADT_SIZE(prop);
+      if (value_size & 0x7ff00000) // up to 1MB properties
+        return -ADT_ERR_BADLENGTH;
+      if (!memchr(prop->name, '\0', sizeof(prop->name)))
+        return -ADT_ERR_BADVALUE;
+
+      offset += sizeof(struct adt_property);
+      if (size - offset < value_size)
+        return -ADT_ERR_BADLENGTH;
+
+      /* Node names are compared as strings */
+      if (!has_name && !strcmp(prop->name, "name")) {
+        if (!memchr(prop->value, '\0', value_size))
+          return -ADT_ERR_BADVALUE;
+        has_name = 1;
+      }
+
+      offset += (value_size + ADT_ALIGN - 1) & ~(ADT_ALIGN - 1);
+      if (offset > size)
+        return -ADT_ERR_BADLENGTH;
+    }
+
+    /* Children are looked up by name, the root never is */
+    if (!has_name && (const u8 *)node != data)
+      return -ADT_ERR_BADVALUE;
+  }
+
+  return 0;
+}
+
 static int _adt_string_eq(const char *a, const char *b, size_t len) {
   return (strlen(a) == len) && (memcmp(a, b, len) == 0);
 }
@@ -68,19 +131,102 @@ static int _adt_nodename_eq(const char *a, const char *b, size_t len) {
     return 0;
 }
 
+/*
+ * Property names live in a fixed 32-byte slot, so a name of up to 31 bytes
+ * matches when the first namelen + 1 bytes of the slot equal the name and its
+ * terminator. Bytes after the terminator are not guaranteed to be zero and are
+ * ignored. The slot is compared against a zero-padded copy of the name with
+ * vector compares when the CPU supports them, checked once at load time.
+ */
+#define ADT_NAME_SLOT sizeof(((struct adt_property *)0)->name)
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define ADT_HAVE_SIMD_SCAN 1
+
+__attribute__((target("avx2"))) static struct adt_property *
+_adt_find_property_avx2(void *adt, int offset, const u8 *key, u32 mask) {
+  const __m256i k = _mm256_loadu_si256((const __m256i *)key);
+
+  ADT_FOREACH_PROPERTY(adt, offset, prop) {
+    const __m256i slot = _mm256_loadu_si256((const __m256i *)prop->name);
+    const u32 eq = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(slot, k));
+    if ((eq & mask) == mask)
+      return prop;
+  }
+
+  return NULL;
+}
+
+__attribute__((target("sse2"))) static struct adt_property *
+_adt_find_property_sse2(void *adt, int offset, const u8 *key, u32 mask) {
+  const __m128i k0 = _mm_loadu_si128((const __m128i *)key);
+  const __m128i k1 = _mm_loadu_si128((const __m128i *)(key + 16));
+
+  ADT_FOREACH_PROPERTY(adt, offset, prop) {
+    const __m128i lo = _mm_loadu_si128((const __m128i *)prop->name);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)(prop->name + 16));
+    const u32 eq = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, k0)) |
+                   ((u32)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, k1)) << 16);
+    if ((eq & mask) == mask)
+      return prop;
+  }
+
+  return NULL;
+}
+
+typedef struct adt_property *(*adt_find_property_fn)(void *adt, int offset,
+                                                     const u8 *key, u32 mask);
+
+/* Widest vector scan the CPU supports, NULL if none */
+static adt_find_property_fn _adt_find_property_simd;
+
+__attribute__((constructor)) static void _adt_select_find_property(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    _adt_find_property_simd = _adt_find_property_avx2;
+  else if (__builtin_cpu_supports("sse2"))
+    _adt_find_property_simd = _adt_find_property_sse2;
+}
+#endif
+
+static struct adt_property *_adt_find_property_scalar(void *adt, int offset,
+                                                      const char *name,
+                                                      size_t namelen) {
+  ADT_FOREACH_PROPERTY(adt, offset, prop) {
+    if (prop->name[namelen] == '\0' && memcmp(prop->name, name, namelen) == 0)
+      return prop;
+  }
+
+  return NULL;
+}
+
 struct adt_property *adt_get_property_namelen(void *adt, int offset,
                                               const char *name,
                                               size_t namelen) {
   dprintf("adt_get_property_namelen(%p, %d, \"%s\", %u)\n", adt, offset, name,
           namelen);
 
-  ADT_FOREACH_PROPERTY(adt, offset, prop) {
-    dprintf(" off=0x%x name=\"%s\"\n", offset, prop->name);
-    if (_adt_string_eq(prop->name, name, namelen))
-      return prop;
+  /* Names that cannot fit in the slot keep the plain string compare */
+  if (namelen >= ADT_NAME_SLOT) {
+    ADT_FOREACH_PROPERTY(adt, offset, prop) {
+      if (_adt_string_eq(prop->name, name, namelen))
+        return prop;
+    }
+    return NULL;
   }
 
-  return NULL;
+#ifdef ADT_HAVE_SIMD_SCAN
+  if (_adt_find_property_simd) {
+    u8 key[ADT_NAME_SLOT] = {0};
+    memcpy(key, name, namelen);
+    const u32 mask = namelen + 1 == 32 ? 0xffffffff : (1u << (namelen + 1)) - 1;
+    return _adt_find_property_simd(adt, offset, key, mask);
+  }
+#endif
+
+  return _adt_find_property_scalar(adt, offset, name, namelen);
 }
 
 struct adt_property *adt_get_property(void *adt, int nodeoffset,
@@ -105,7 +251,7 @@ void *adt_getprop_namelen(void *adt, int nodeoffset, const char *name,
     return NULL;
 
   if (lenp)
-    *lenp = prop->size;
+    *lenp = ADT_SIZE(prop);
 
   return prop->value;
 }
@@ -121,7 +267,7 @@ void *adt_getprop_by_offset(void *adt, int offset, const char **namep,
   if (namep)
     *namep = prop->name;
   if (lenp)
-    *lenp = prop->size;
+    *lenp = ADT_SIZE(prop);
   return prop->value;
 }
 
@@ -175,6 +321,11 @@ int adt_subnode_offset_namelen(void *adt, int offset, const char *name,
                                size_t namelen) {
   ADT_CHECK_HEADER(adt);
 
+  return adt_subnode_offset_namelen_unchecked(adt, offset, name, namelen);
+}
+
+int adt_subnode_offset_namelen_unchecked(void *adt, int offset,
+                                         const char *name, size_t namelen) {
   ADT_FOREACH_CHILD(adt, offset) {
     const char *cname = adt_get_name(adt, offset);
 
@@ -194,12 +345,21 @@ int adt_path_offset(void *adt, const char *path) {
 }
 
 int adt_path_offset_trace(void *adt, const char *path, int *offsets) {
+  ADT_CHECK_HEADER(adt);
+
+  return adt_path_offset_trace_unchecked(adt, path, offsets);
+}
+
+int adt_path_offset_unchecked(void *adt, const char *path) {
+  return adt_path_offset_trace_unchecked(adt, path, NULL);
+}
+
+int adt_path_offset_trace_unchecked(void *adt, const char *path,
+                                    int *offsets) {
   const char *end = path + strlen(path);
   const char *p = path;
   int offset = 0;
 
-  ADT_CHECK_HEADER(adt);
-
   while (*p) {
     const char *q;
 
@@ -211,7 +371,7 @@ int adt_path_offset_trace(void *adt, const char *path, int *offsets) {
     if (!q)
       q = end;
 
-    offset = adt_subnode_offset_namelen(adt, offset, p, q - p);
+    offset = adt_subnode_offset_namelen_unchecked(adt, offset, p, q - p);
     if (offset < 0)
       break;
 
@@ -0,0 +1,139 @@
+#include "adt_address_map.h"
+
+#include <algorithm>
+
+#include "adt.h"
+
+namespace {
+
+// Reads a number made of `count` 32-bit cells, least significant first, like
+// get_cells() in adt.c
+uint64_t ReadCells(const uint32_t *&cells, uint32_t count) {
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    value |= uint64_t{*cells++} << (32 * i);
+  }
+  return value;
+}
+
+} // namespace
+
+AdtAddressMap AdtAddressMap::Build(uint8_t *adt, const AdtIndex &index) {
+  AdtAddressMap map;
+  // Nodes are visited in pre-order, so the bus of the parent of a node is
+  // always decoded before the node
+  std::vector<Bus> buses(index.size());
+  for (uint32_t i = 0; i < index.size(); i++) {
+    const uint32_t offset = index[i].offset;
+    Bus &bus = buses[i];
+    ADT_GETPROP(adt, offset, "#address-cells", &bus.address_cells);
+    ADT_GETPROP(adt, offset, "#size-cells", &bus.size_cells);
+    bus.valid = bus.address_cells >= 1 && bus.address_cells <= 2 &&
+                bus.size_cells <= 2;
+
+    const uint32_t parent = index[i].parent;
+    if (parent == AdtIndex::kNone || !buses[parent].valid) {
+      continue;
+    }
+    const Bus &parent_bus = buses[parent];
+
+    u32 size;
+    const auto *ranges = static_cast<const uint32_t *>(
+        adt_getprop(adt, offset, "ranges", &size));
+    if (ranges != nullptr && bus.valid) {
+      bus.has_ranges = true;
+      const uint32_t cells = bus.address_cells + parent_bus.address_cells +
+                             bus.size_cells;
+      for (uint32_t n = size / (4 * cells); n > 0; n--) {
+        Range &range = bus.ranges.emplace_back();
+        range.child = ReadCells(ranges, bus.address_cells);
+        range.parent = ReadCells(ranges, parent_bus.address_cells);
+        range.size = ReadCells(ranges, bus.size_cells);
+      }
+    }
+
+    const auto *reg =
+        static_cast<const uint32_t *>(adt_getprop(adt, offset, "reg", &size));
+    if (reg == nullptr) {
+      continue;
+    }
+    const uint32_t cells = parent_bus.address_cells + parent_bus.size_cells;
+    const uint32_t entries = size / (4 * cells);
+    for (uint32_t entry = 0; entry < entries; entry++) {
+      const uint64_t address = ReadCells(reg, parent_bus.address_cells);
+      const uint64_t window_size = ReadCells(reg, parent_bus.size_cells);
+      map.m_windows.push_back(
+          {Translate(index, buses, parent, address, window_size), window_size,
+           i, entry});
+    }
+  }
+
+  std::stable_sort(
+      map.m_windows.begin(), map.m_windows.end(),
+      [](const Window &a, const Window &b) { return a.address < b.address; });
+  map.m_max_ends.resize(map.m_windows.size());
+  map.BuildMaxEnds(0, map.m_windows.size());
+  return map;
+}
+
+std::vector<AdtAddressMap::Window>
+AdtAddressMap::Find(uint64_t address) const {
+  std::vector<Window> windows;
+  Find(0, m_windows.size(), address, windows);
+  return windows;
+}
+
+uint64_t AdtAddressMap::Translate(const AdtIndex &index,
+                                  const std::vector<Bus> &buses,
+                                  uint32_t node, uint64_t address,
+                                  uint64_t size) {
+  // The ranges of the root are never applied
+  for (; index[node].parent != AdtIndex::kNone; node = index[node].parent) {
+    const Bus &bus = buses[node];
+    if (!bus.has_ranges) {
+      break;
+    }
+    for (const Range &range : bus.ranges) {
+      if (address >= range.child &&
+          address + size <= range.child + range.size) {
+        address = address - range.child + range.parent;
+        break;
+      }
+    }
+  }
+  return address;
+}
+
+// The implicit tree over a range of windows is rooted at its middle window,
+// with the windows before and after it as its subtrees
+uint64_t AdtAddressMap::BuildMaxEnds(size_t begin, size_t end) {
+  if (begin == end) {
+    return 0;
+  }
+  const size_t middle = begin + (end - begin) / 2;
+  m_max_ends[middle] =
+      std::max({m_windows[middle].End(), BuildMaxEnds(begin, middle),
+                BuildMaxEnds(middle + 1, end)});
+  return m_max_ends[middle];
+}
+
+void AdtAddressMap::Find(size_t begin, size_t end, uint64_t address,
+                         std::vector<Window> &windows) const {
+  if (begin == end) {
+    return;
+  }
+  const size_t middle = begin + (end - begin) / 2;
+  if (m_max_ends[middle] <= address) {
+    return;
+  }
+
+  Find(begin, middle, address, windows);
+  // Windows after this one start after it
+  if (m_windows[middle].address > address) {
+    return;
+  }
+  if (address < m_windows[middle].End()) {
+    windows.push_back(m_windows[middle]);
+  }
+  Find(middle + 1, end, address, windows);
+}
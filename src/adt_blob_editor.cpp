@@ -0,0 +1,257 @@
+#include "adt_blob_editor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "adt.h"
+#include "fmt/core.h"
+#include "utils.h"
+
+using Error = AdtModder::Error;
+using Ditto::Result;
+
+Result<AdtBlobEditor, Error>
+AdtBlobEditor::Create(std::vector<uint8_t> &adt) noexcept {
+  auto index = AdtIndex::Build(adt);
+  if (index.is_error()) {
+    fmt::print("AdtModder: Unable to index the ADT, it is malformed\n");
+    return Error::MalformedAdt;
+  }
+  return AdtBlobEditor{adt, std::move(index.ok_value())};
+}
+
+Result<AdtModder::Node, Error>
+AdtBlobEditor::FindNode(std::string_view path) {
+  m_counters.path_lookups++;
+  const int offset = m_paths.Resolve(m_index, m_adt.data(), path);
+  if (offset < 0) {
+    fmt::print("Could not find node \"{}\"\n", path);
+    return Error::NodeNotFound;
+  }
+  return AdtModder::Node{static_cast<uint32_t>(offset)};
+}
+
+void AdtBlobEditor::PinNodes(Ditto::span<const uint32_t> nodes) {
+  for (const uint32_t node : nodes) {
+    m_paths.Pin(node, m_index[node].offset);
+  }
+}
+
+Result<AdtModder::Node, Error> AdtBlobEditor::FindPinnedNode(uint32_t node) {
+  const uint32_t offset = m_paths.Pinned(node);
+  if (offset == AdtIndex::kNone) {
+    return Error::NodeNotFound;
+  }
+  return AdtModder::Node{offset};
+}
+
+Result<Ditto::span<uint8_t>, Error>
+AdtBlobEditor::FindProperty(AdtModder::Node node, std::string_view name) {
+  m_counters.property_lookups++;
+  const int offset =
+      m_properties.Find(m_index, m_adt.data(), node.offset, name);
+  if (offset < 0) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+  // The value is handed out writable, so the node may be renamed through it
+  if (name == "name") {
+    m_paths.OnRename(m_index, node.offset);
+  }
+  auto *prop = ADT_PROP(m_adt.data(), offset);
+  return Ditto::span<uint8_t>{&prop->value[0], ADT_SIZE(prop)};
+}
+
+void AdtBlobEditor::FindProperties(
+    AdtModder::Node node, Ditto::span<const std::string_view> names,
+    std::vector<std::optional<Ditto::span<uint8_t>>> &values) {
+  values.assign(names.size(), std::nullopt);
+  m_counters.property_lookups += names.size();
+
+  // Nodes with many properties are looked up through their property table,
+  // the others are walked once, matching every name against each property.
+  // As in adt_get_property_namelen, the first property with a name wins.
+  uint8_t *data = m_adt.data();
+  if (static_cast<uint32_t>(adt_get_property_count(data, node.offset)) >=
+      AdtPropertyIndex::kMinProperties) {
+    for (size_t j = 0; j < names.size(); j++) {
+      const int offset =
+          m_properties.Find(m_index, data, node.offset, names[j]);
+      if (offset >= 0) {
+        auto *prop = ADT_PROP(data, offset);
+        values[j] = Ditto::span<uint8_t>{&prop->value[0], ADT_SIZE(prop)};
+      }
+    }
+  } else {
+    size_t remaining = names.size();
+    int offset = adt_first_property_offset(data, node.offset);
+    for (int i = adt_get_property_count(data, node.offset);
+         i > 0 && remaining > 0; i--) {
+      auto *prop = ADT_PROP(data, offset);
+      const std::string_view prop_name{
+          prop->name, strnlen(prop->name, sizeof(prop->name))};
+      for (size_t j = 0; j < names.size(); j++) {
+        if (!values[j].has_value() && names[j] == prop_name) {
+          values[j] = Ditto::span<uint8_t>{&prop->value[0], ADT_SIZE(prop)};
+          remaining--;
+        }
+      }
+      offset = adt_next_property_offset(data, offset);
+    }
+  }
+
+  for (size_t j = 0; j < names.size(); j++) {
+    if (!values[j].has_value()) {
+      fmt::print("Could not find property \"{}\"\n", names[j]);
+    } else if (names[j] == "name") {
+      m_paths.OnRename(m_index, node.offset);
+    }
+  }
+}
+
+AdtModder::Result AdtBlobEditor::AddNode(std::string_view path) {
+  m_counters.path_lookups += 2;
+  // Check if node already exists
+  if (m_paths.Resolve(m_index, m_adt.data(), path) >= 0) {
+    return Error::NodeAlreadyExists;
+  }
+
+  const auto last_node_separator_index = path.find_last_of('/');
+  const std::string_view parent_node_name =
+      path.substr(0, last_node_separator_index);
+  const std::string_view child_node_name =
+      path.substr(last_node_separator_index + 1);
+
+  const auto parent_node_offset =
+      m_paths.Resolve(m_index, m_adt.data(), parent_node_name);
+  if (parent_node_offset < 0) {
+    fmt::print("Parent node does not exist: {}", parent_node_name);
+    return Error::NodeNotFound;
+  }
+
+  const auto next_sibling_offset =
+      m_index.NextSiblingOffset(parent_node_offset);
+
+  // New node will be empty, just header + name property (prop_value =
+  // child_node_name + '\0')
+  // All nodes should align to 32 bit boundaries
+  const size_t new_node_size =
+      utils::roundUpToAlignment(sizeof(adt_node_hdr) + sizeof(adt_property) +
+                                    child_node_name.length() + 1,
+                                sizeof(uint32_t));
+
+  const auto prev_size = m_adt.size();
+  Resize(prev_size + new_node_size);
+
+  // Move the mem upwards
+  memmove(&m_adt[next_sibling_offset + new_node_size],
+          &m_adt[next_sibling_offset], prev_size - next_sibling_offset);
+  m_counters.bytes_moved += prev_size - next_sibling_offset;
+  auto parent_node = ADT_NODE(m_adt.data(), parent_node_offset);
+  // Increase the child count
+  parent_node->child_count++;
+
+  // And now write the child!
+  const auto child_offset = next_sibling_offset;
+  memset(&m_adt[child_offset], 0, new_node_size);
+  auto new_node = ADT_NODE(m_adt.data(), child_offset);
+  new_node->property_count = 1; // Just the name
+  new_node->child_count = 0;    // No children
+
+  // Filling name property
+  auto name_prop = ADT_PROP(
+      m_adt.data(), adt_first_property_offset(m_adt.data(), child_offset));
+  name_prop->size = child_node_name.length() + 1;
+  memcpy(&name_prop->name[0], "name", 5);
+  memcpy(&name_prop->value[0], child_node_name.data(),
+         child_node_name.length());
+
+  m_index.OnNodeAdded(m_adt.data(), parent_node_offset, child_offset,
+                      new_node_size);
+  m_properties.OnNodeAdded(m_index, child_offset);
+  m_paths.OnInsert(child_offset, new_node_size);
+  m_paths.Insert(path, child_offset);
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result
+AdtBlobEditor::AddProperty(AdtModder::Node node, std::string_view name,
+                           Ditto::span<const uint8_t> value) {
+  const auto insertion_offset = m_index.FirstChildOffset(node.offset);
+
+  // Calculate size of the property
+  const size_t property_size = utils::roundUpToAlignment(
+      sizeof(adt_property) + value.size(), sizeof(uint32_t));
+
+  // Resize the vector
+  const auto old_size = m_adt.size();
+  Resize(old_size + property_size);
+
+  // Shift the data, making space for the property
+  memmove(&m_adt[insertion_offset + property_size], &m_adt[insertion_offset],
+          old_size - insertion_offset);
+  m_counters.bytes_moved += old_size - insertion_offset;
+
+  // Increase property count
+  ADT_NODE(m_adt.data(), node.offset)->property_count++;
+
+  memset(&m_adt[insertion_offset], 0, property_size);
+  const auto property = ADT_PROP(m_adt.data(), insertion_offset);
+  memcpy(property->name, name.data(), name.length());
+
+  property->size = value.size();
+  memcpy(&property->value[0], value.data(), value.size());
+
+  m_index.OnPropertyAdded(m_adt.data(), node.offset, insertion_offset,
+                          property_size);
+  m_properties.OnPropertyAdded(m_index, m_adt.data(), node.offset,
+                               insertion_offset, property_size);
+  m_paths.OnInsert(insertion_offset, property_size);
+  if (name == "name") {
+    m_paths.OnRename(m_index, node.offset);
+  }
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtBlobEditor::DeleteProperty(AdtModder::Node node,
+                                                std::string_view name) {
+  m_counters.property_lookups++;
+  uint8_t *data = m_adt.data();
+  const int prop_offset = m_properties.Find(m_index, data, node.offset, name);
+  if (prop_offset < 0) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+
+  int next_prop_offset = adt_next_property_offset(data, prop_offset);
+
+  uint32_t copy_length = m_adt.size() - next_prop_offset;
+  memmove(&m_adt[prop_offset], &m_adt[next_prop_offset], copy_length);
+  m_counters.bytes_moved += copy_length;
+
+  // The node now has one less property
+  ADT_NODE(data, node.offset)->property_count--;
+
+  const uint32_t removed_size = next_prop_offset - prop_offset;
+  m_adt.resize(m_adt.size() - removed_size);
+
+  m_index.OnPropertyRemoved(m_adt.data(), node.offset, prop_offset,
+                            removed_size);
+  m_properties.OnPropertyRemoved(m_index, node.offset, name, prop_offset,
+                                 removed_size);
+  m_paths.OnRemove(prop_offset, removed_size);
+  if (name == "name") {
+    m_paths.OnRename(m_index, node.offset);
+  }
+  return AdtModder::Result::ok();
+}
+
+void AdtBlobEditor::Resize(size_t size) {
+  if (size > m_adt.capacity()) {
+    m_counters.reallocations++;
+  }
+  m_adt.resize(size);
+  m_counters.peak_adt_size =
+      std::max<uint64_t>(m_counters.peak_adt_size, size);
+}
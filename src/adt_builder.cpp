@@ -0,0 +1,375 @@
+#include "adt_builder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+#include "adt.h"
+#include "fmt/core.h"
+#include "utils.h"
+
+using Ditto::Result;
+using nlohmann::ordered_json;
+
+namespace {
+
+// Limits of adt_validate()
+constexpr size_t kMaxCount = 2048;
+constexpr size_t kMaxValueSize = 0xfffff;
+
+int HexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+const ordered_json *Find(const ordered_json &object, const char *key) {
+  const auto it = object.find(key);
+  return it == object.end() ? nullptr : &*it;
+}
+
+// Whether the "name" of a node is written as a property of its own
+bool HasNameKey(const ordered_json &node) {
+  const auto *properties = Find(node, "properties");
+  return node.contains("name") &&
+         (properties == nullptr || !properties->contains("name"));
+}
+
+// Visits every node in pre-order, the order of the nodes of an ADT, stopping
+// at the first error `visit` returns
+template <typename Visit>
+std::optional<std::string> Walk(const ordered_json &root, Visit visit) {
+  // Parents of the node being visited, with the index of their next child
+  std::vector<std::pair<const ordered_json *, size_t>> parents;
+  const ordered_json *node = &root;
+  while (true) {
+    auto error = visit(*node, parents.empty());
+    if (error.has_value()) {
+      return error;
+    }
+    parents.emplace_back(node, 0);
+
+    while (!parents.empty()) {
+      auto &[parent, next] = parents.back();
+      const auto *children = Find(*parent, "children");
+      if (children != nullptr && next < children->size()) {
+        node = &(*children)[next++];
+        break;
+      }
+      parents.pop_back();
+    }
+    if (parents.empty()) {
+      return std::nullopt;
+    }
+  }
+}
+
+// Whether `value` is one of the tagged values typed dumps write
+bool IsTagged(const ordered_json &value) {
+  return value.is_object() && value.size() == 1 &&
+         (value.contains("u32") || value.contains("u64") ||
+          value.contains("hex"));
+}
+
+template <typename Number>
+void AppendNumber(std::vector<uint8_t> &out, Number number) {
+  const size_t size = out.size();
+  out.resize(size + sizeof(number));
+  memcpy(&out[size], &number, sizeof(number));
+}
+
+// Encodes a list of strings, or a value tagged with its type, like typed
+// dumps write them
+Result<std::vector<uint8_t>, std::string>
+EncodeDumped(const ordered_json &value) {
+  std::vector<uint8_t> encoded;
+  if (value.is_array()) {
+    if (value.empty()) {
+      return std::string{"Lists of strings can't be empty"};
+    }
+    for (const auto &string : value) {
+      if (!string.is_string()) {
+        return std::string{"Lists should only hold strings"};
+      }
+      const auto &chars = string.get_ref<const std::string &>();
+      encoded.insert(encoded.end(), chars.begin(), chars.end());
+      encoded.push_back('\0');
+    }
+    return encoded;
+  }
+
+  const std::string &tag = value.begin().key();
+  const ordered_json &contents = value.begin().value();
+  if (tag == "hex") {
+    if (!contents.is_string()) {
+      return std::string{"Hex values should be strings"};
+    }
+    const auto &hex = contents.get_ref<const std::string &>();
+    if (hex.size() % 2 != 0) {
+      return std::string{"Hex values need an even number of digits"};
+    }
+    for (size_t i = 0; i < hex.size(); i += 2) {
+      const int high = HexDigit(hex[i]);
+      const int low = HexDigit(hex[i + 1]);
+      if (high < 0 || low < 0) {
+        return fmt::format("Invalid hex digit in \"{}\"", hex);
+      }
+      encoded.push_back(high << 4 | low);
+    }
+    return encoded;
+  }
+  if (tag == "u64") {
+    if (!contents.is_number_unsigned()) {
+      return std::string{"u64 values should be unsigned numbers"};
+    }
+    AppendNumber(encoded, contents.get<uint64_t>());
+    return encoded;
+  }
+
+  // A single u32, or an array of them
+  const auto append_u32 = [&encoded](const ordered_json &number) {
+    if (!number.is_number_unsigned() || number.get<uint64_t>() > UINT32_MAX) {
+      return false;
+    }
+    AppendNumber(encoded, static_cast<uint32_t>(number.get<uint64_t>()));
+    return true;
+  };
+  const bool valid =
+      contents.is_array()
+          ? !contents.empty() &&
+                std::all_of(contents.begin(), contents.end(), append_u32)
+          : append_u32(contents);
+  if (!valid) {
+    return std::string{"u32 values should be unsigned 32-bit numbers, or "
+                       "non-empty arrays of them"};
+  }
+  return encoded;
+}
+
+// Bytes of the name of a node, given as a string or as {"hex": ...}, like
+// dumps write names json strings can't hold
+std::optional<std::string> NameBytes(const ordered_json &name) {
+  if (name.is_string()) {
+    return name.get<std::string>();
+  }
+  if (!name.is_object() || name.size() != 1 || !name.contains("hex")) {
+    return std::nullopt;
+  }
+  auto bytes = EncodeDumped(name);
+  if (bytes.is_error()) {
+    return std::nullopt;
+  }
+  return std::string{bytes.ok_value().begin(), bytes.ok_value().end()};
+}
+
+} // namespace
+
+Result<std::vector<uint8_t>, std::string>
+AdtBuilder::Build(const ordered_json &root) {
+  m_encoded.clear();
+  m_next_encoded = 0;
+  const size_t size = DITTO_PROPAGATE(Measure(root));
+
+  std::vector<uint8_t> adt(size);
+  Write(root, adt.data());
+  return adt;
+}
+
+Result<size_t, std::string> AdtBuilder::Measure(const ordered_json &root) {
+  size_t size = 0;
+  auto error = Walk(root, [&](const ordered_json &node,
+                              bool is_root) -> std::optional<std::string> {
+    if (!node.is_object()) {
+      return std::string{"Nodes should be objects"};
+    }
+    const auto *name = Find(node, "name");
+    const auto name_bytes =
+        name != nullptr ? NameBytes(*name) : std::optional<std::string>{""};
+    if (!name_bytes.has_value()) {
+      return std::string{"Node names should be strings or {\"hex\": ...}"};
+    }
+    const std::string &node_name = *name_bytes;
+
+    const auto *children = Find(node, "children");
+    if (children != nullptr && !children->is_array()) {
+      return fmt::format("Children of node \"{}\" should be an array",
+                         node_name);
+    }
+    if (children != nullptr && children->size() > kMaxCount) {
+      return fmt::format("Node \"{}\" has more than {} children", node_name,
+                         kMaxCount);
+    }
+
+    const auto *properties = Find(node, "properties");
+    if (properties != nullptr && !properties->is_object()) {
+      return fmt::format("Properties of node \"{}\" should be an object",
+                         node_name);
+    }
+    const bool name_key = HasNameKey(node);
+    const size_t count =
+        (properties != nullptr ? properties->size() : 0) + name_key;
+    if (count > kMaxCount) {
+      return fmt::format("Node \"{}\" has more than {} properties",
+                         node_name, kMaxCount);
+    }
+    if (is_root && count == 0) {
+      return std::string{"The root node needs at least one property"};
+    }
+    if (!is_root && name == nullptr &&
+        (properties == nullptr || !properties->contains("name"))) {
+      return std::string{"Nodes other than the root need a name"};
+    }
+
+    size += sizeof(adt_node_hdr);
+    if (name_key) {
+      size += sizeof(adt_property) +
+              utils::roundUpToAlignment(node_name.size() + 1, ADT_ALIGN);
+    }
+    if (properties == nullptr) {
+      return std::nullopt;
+    }
+    for (const auto &[key, value] : properties->items()) {
+      if (key.size() > MAX_PROPERTY_NAME_LENGTH) {
+        return fmt::format("Property name is too long `{}`", key);
+      }
+      const auto value_size = MeasureValue(value);
+      if (value_size.is_error()) {
+        return fmt::format("Property \"{}\" of node \"{}\": {}", key,
+                           node_name, value_size.error_value());
+      }
+      if (key == "name" && !IsTerminated(value)) {
+        return fmt::format("The name of node \"{}\" should be "
+                           "null-terminated",
+                           node_name);
+      }
+      size += sizeof(adt_property) +
+              utils::roundUpToAlignment(value_size.ok_value(), ADT_ALIGN);
+    }
+    // Checked on every node, so the size never overflows
+    if (size > INT32_MAX) {
+      return std::string{"The ADT would be larger than 2GB"};
+    }
+    return std::nullopt;
+  });
+
+  if (error.has_value()) {
+    return *error;
+  }
+  return size;
+}
+
+bool AdtBuilder::IsTerminated(const ordered_json &value) const {
+  if (value.is_object() || value.is_array()) {
+    const auto &encoded = m_encoded.back();
+    return memchr(encoded.data(), '\0', encoded.size()) != nullptr;
+  }
+  if (!m_hex_values) {
+    return true;
+  }
+  const auto &hex = value.get_ref<const std::string &>();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    if (hex[i] == '0' && hex[i + 1] == '0') {
+      return true;
+    }
+  }
+  return false;
+}
+
+Result<size_t, std::string>
+AdtBuilder::MeasureValue(const ordered_json &value) {
+  size_t size;
+  if (value.is_string() && m_hex_values) {
+    const auto &hex = value.get_ref<const std::string &>();
+    if (hex.size() % 2 != 0) {
+      return std::string{"Hex values need an even number of digits"};
+    }
+    for (const char c : hex) {
+      if (HexDigit(c) < 0) {
+        return fmt::format("Invalid hex digit '{}'", c);
+      }
+    }
+    size = hex.size() / 2;
+  } else if (value.is_string()) {
+    size = value.get_ref<const std::string &>().size() + 1;
+  } else if (IsTagged(value) || value.is_array()) {
+    auto encoded = DITTO_PROPAGATE(EncodeDumped(value));
+    size = encoded.size();
+    m_encoded.push_back(std::move(encoded));
+  } else if (value.is_object()) {
+    // The {"type": ..., "contents": ...} objects of add_property encode u32
+    // in 8 bytes, so they would give "u32" two widths in the same file
+    return std::string{"Typed values should be {\"u32\": ...}, "
+                       "{\"u64\": ...} or {\"hex\": ...}"};
+  } else {
+    return std::string{"Values should be strings, lists of strings or typed "
+                       "values"};
+  }
+
+  if (size > kMaxValueSize) {
+    return std::string{"Values should be smaller than 1MB"};
+  }
+  return size;
+}
+
+void AdtBuilder::Write(const ordered_json &root, uint8_t *adt) {
+  size_t offset = 0;
+  Walk(root, [&](const ordered_json &node,
+                 bool) -> std::optional<std::string> {
+    const auto *properties = Find(node, "properties");
+    const auto *children = Find(node, "children");
+    const bool name_key = HasNameKey(node);
+
+    auto *header = ADT_NODE(adt, offset);
+    header->property_count =
+        (properties != nullptr ? properties->size() : 0) + name_key;
+    header->child_count = children != nullptr ? children->size() : 0;
+    offset += sizeof(adt_node_hdr);
+
+    // The buffer is zeroed, so names and strings are already terminated
+    if (name_key) {
+      const std::string name = *NameBytes(node["name"]);
+      auto *property = ADT_PROP(adt, offset);
+      memcpy(property->name, "name", strlen("name"));
+      memcpy(property->value, name.data(), name.size());
+      property->size = name.size() + 1;
+      offset += sizeof(adt_property) +
+                utils::roundUpToAlignment(property->size, ADT_ALIGN);
+    }
+    if (properties == nullptr) {
+      return std::nullopt;
+    }
+    for (const auto &[key, value] : properties->items()) {
+      auto *property = ADT_PROP(adt, offset);
+      memcpy(property->name, key.data(), key.size());
+      property->size = WriteValue(value, property->value);
+      offset += sizeof(adt_property) +
+                utils::roundUpToAlignment(property->size, ADT_ALIGN);
+    }
+    return std::nullopt;
+  });
+}
+
+size_t AdtBuilder::WriteValue(const ordered_json &value, uint8_t *out) {
+  if (value.is_object() || value.is_array()) {
+    const auto &encoded = m_encoded[m_next_encoded++];
+    memcpy(out, encoded.data(), encoded.size());
+    return encoded.size();
+  }
+
+  const auto &string = value.get_ref<const std::string &>();
+  if (!m_hex_values) {
+    memcpy(out, string.data(), string.size());
+    return string.size() + 1;
+  }
+  for (size_t i = 0; i < string.size(); i += 2) {
+    *out++ = HexDigit(string[i]) << 4 | HexDigit(string[i + 1]);
+  }
+  return string.size() / 2;
+}
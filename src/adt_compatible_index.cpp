@@ -0,0 +1,41 @@
+#include "adt_compatible_index.h"
+
+#include <cstring>
+
+#include "adt.h"
+
+AdtCompatibleIndex AdtCompatibleIndex::Build(uint8_t *adt,
+                                             const AdtIndex &index) {
+  AdtCompatibleIndex compatible_index;
+  for (uint32_t i = 0; i < index.size(); i++) {
+    u32 size;
+    const auto *value = static_cast<const char *>(
+        adt_getprop(adt, index[i].offset, "compatible", &size));
+    if (value == nullptr) {
+      continue;
+    }
+
+    // A list of null-terminated strings. The last one may lack its
+    // terminator.
+    const char *end = value + size;
+    while (value < end) {
+      const size_t length = strnlen(value, end - value);
+      if (length > 0) {
+        auto &nodes = compatible_index.m_nodes[{value, length}];
+        // Strings listed twice by the same node
+        if (nodes.empty() || nodes.back() != i) {
+          nodes.push_back(i);
+        }
+      }
+      value += length + 1;
+    }
+  }
+  return compatible_index;
+}
+
+const std::vector<uint32_t> &
+AdtCompatibleIndex::Find(std::string_view compatible) const {
+  static const std::vector<uint32_t> kNoNodes;
+  const auto it = m_nodes.find(compatible);
+  return it == m_nodes.end() ? kNoNodes : it->second;
+}
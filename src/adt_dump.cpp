@@ -0,0 +1,236 @@
+#include "adt_dump.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "adt.h"
+
+namespace {
+
+bool IsPrintable(uint8_t c) { return c >= 0x20 && c < 0x7f; }
+
+// Whether the value is a list of one or more non-empty printable strings,
+// each of them null-terminated
+bool IsStringList(Ditto::span<const uint8_t> value) {
+  if (value.size() == 0 || value[value.size() - 1] != 0) {
+    return false;
+  }
+  bool in_string = false;
+  for (size_t i = 0; i < value.size(); i++) {
+    if (value[i] == 0) {
+      if (!in_string) {
+        return false;
+      }
+      in_string = false;
+    } else if (IsPrintable(value[i])) {
+      in_string = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether json readers give back the same bytes WriteString() writes the
+// string as. Bytes above 0x7f are written as code points, which read back as
+// two bytes of UTF-8.
+bool RoundTrips(std::string_view string) {
+  return std::none_of(string.begin(), string.end(), [](char c) {
+    return static_cast<uint8_t>(c) >= 0x80;
+  });
+}
+
+} // namespace
+
+std::optional<std::string> AdtDumper::FindUnwritableName(uint8_t *adt,
+                                                         int offset) {
+  std::vector<int> pending{offset};
+  while (!pending.empty()) {
+    int node = pending.back();
+    pending.pop_back();
+    ADT_FOREACH_PROPERTY(adt, node, prop) {
+      const std::string_view name{prop->name,
+                                  strnlen(prop->name, sizeof(prop->name))};
+      if (!RoundTrips(name)) {
+        return std::string{name};
+      }
+    }
+    ADT_FOREACH_CHILD(adt, node) { pending.push_back(node); }
+  }
+  return std::nullopt;
+}
+
+Ditto::Result<void, File::Error> AdtDumper::Dump(uint8_t *adt, int offset) {
+  // Children left to write of every node being written. Nodes are laid out in
+  // pre-order, so the next node always starts where the previous one's
+  // properties end.
+  std::vector<uint32_t> children_left;
+  bool first_child = true;
+  while (true) {
+    if (!first_child) {
+      m_buffer.push_back(',');
+    }
+    children_left.push_back(adt_get_child_count(adt, offset));
+    offset = WriteNode(adt, offset);
+    first_child = true;
+
+    while (!children_left.empty() && children_left.back() == 0) {
+      m_buffer.push_back(']');
+      m_buffer.push_back('}');
+      children_left.pop_back();
+      first_child = false;
+    }
+    if (children_left.empty()) {
+      m_buffer.push_back('\n');
+      return Flush(true);
+    }
+    children_left.back()--;
+
+    auto result = Flush(false);
+    if (result.is_error()) {
+      return result;
+    }
+  }
+}
+
+int AdtDumper::WriteNode(uint8_t *adt, int offset) {
+  constexpr std::string_view kName = "\"name\":";
+  constexpr std::string_view kProperties = "\"properties\":{";
+  constexpr std::string_view kChildren = "},\"children\":[";
+
+  m_buffer.push_back('{');
+  // Only the root may lack a name
+  if (const char *name = adt_get_name(adt, offset); name != nullptr) {
+    m_buffer.append(kName.begin(), kName.end());
+    if (RoundTrips(name)) {
+      WriteString(name);
+    } else {
+      WriteTaggedHex({reinterpret_cast<const uint8_t *>(name), strlen(name)});
+    }
+    m_buffer.push_back(',');
+  }
+  m_buffer.append(kProperties.begin(), kProperties.end());
+
+  int end = adt_first_property_offset(adt, offset);
+  ADT_FOREACH_PROPERTY(adt, offset, prop) {
+    if (end != adt_first_property_offset(adt, offset)) {
+      m_buffer.push_back(',');
+    }
+    WriteString({prop->name, strnlen(prop->name, sizeof(prop->name))});
+    m_buffer.push_back(':');
+    WriteValue({prop->value, ADT_SIZE(prop)});
+    end = adt_next_property_offset(
+        adt, static_cast<int>(reinterpret_cast<uint8_t *>(prop) - adt));
+  }
+
+  m_buffer.append(kChildren.begin(), kChildren.end());
+  return end;
+}
+
+void AdtDumper::WriteValue(Ditto::span<const uint8_t> value) {
+  if (!m_typed) {
+    WriteHex(value);
+    return;
+  }
+
+  if (IsStringList(value)) {
+    const char *string = reinterpret_cast<const char *>(value.data());
+    const char *end = string + value.size();
+    const bool list = strlen(string) + 1 < value.size();
+    if (list) {
+      m_buffer.push_back('[');
+    }
+    for (; string < end; string += strlen(string) + 1) {
+      if (string != reinterpret_cast<const char *>(value.data())) {
+        m_buffer.push_back(',');
+      }
+      WriteString(string);
+    }
+    if (list) {
+      m_buffer.push_back(']');
+    }
+    return;
+  }
+
+  // Anything else is tagged with its type, so it is never mistaken for a
+  // string and keeps its width
+  if (value.size() == sizeof(uint64_t)) {
+    uint64_t number;
+    memcpy(&number, value.data(), sizeof(number));
+    fmt::format_to(std::back_inserter(m_buffer), "{{\"u64\":{}}}", number);
+    return;
+  }
+  if (value.size() == 0 || value.size() % sizeof(uint32_t) != 0) {
+    WriteTaggedHex(value);
+    return;
+  }
+
+  constexpr std::string_view kU32 = "{\"u32\":";
+  m_buffer.append(kU32.begin(), kU32.end());
+  const size_t count = value.size() / sizeof(uint32_t);
+  if (count > 1) {
+    m_buffer.push_back('[');
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint32_t number;
+    memcpy(&number, &value[i * sizeof(number)], sizeof(number));
+    if (i > 0) {
+      m_buffer.push_back(',');
+    }
+    fmt::format_to(std::back_inserter(m_buffer), "{}", number);
+  }
+  if (count > 1) {
+    m_buffer.push_back(']');
+  }
+  m_buffer.push_back('}');
+}
+
+void AdtDumper::WriteString(std::string_view string) {
+  constexpr char kDigits[] = "0123456789abcdef";
+  m_buffer.push_back('"');
+  for (const char c : string) {
+    const auto byte = static_cast<uint8_t>(c);
+    if (c == '"' || c == '\\') {
+      m_buffer.push_back('\\');
+      m_buffer.push_back(c);
+    } else if (IsPrintable(byte)) {
+      m_buffer.push_back(c);
+    } else {
+      // Names are not guaranteed to be ASCII, other bytes are written as
+      // the code point of the same value
+      constexpr std::string_view kEscape = "\\u00";
+      m_buffer.append(kEscape.begin(), kEscape.end());
+      m_buffer.push_back(kDigits[byte >> 4]);
+      m_buffer.push_back(kDigits[byte & 0xf]);
+    }
+  }
+  m_buffer.push_back('"');
+}
+
+void AdtDumper::WriteHex(Ditto::span<const uint8_t> value) {
+  constexpr char kDigits[] = "0123456789abcdef";
+  m_buffer.push_back('"');
+  for (const uint8_t byte : value) {
+    m_buffer.push_back(kDigits[byte >> 4]);
+    m_buffer.push_back(kDigits[byte & 0xf]);
+  }
+  m_buffer.push_back('"');
+}
+
+void AdtDumper::WriteTaggedHex(Ditto::span<const uint8_t> value) {
+  constexpr std::string_view kHex = "{\"hex\":";
+  m_buffer.append(kHex.begin(), kHex.end());
+  WriteHex(value);
+  m_buffer.push_back('}');
+}
+
+Ditto::Result<void, File::Error> AdtDumper::Flush(bool force) {
+  if (!force && m_buffer.size() < kFlushSize) {
+    return Ditto::Result<void, File::Error>::ok();
+  }
+  auto result = m_out.Write(
+      {reinterpret_cast<uint8_t *>(m_buffer.data()), m_buffer.size()});
+  m_buffer.clear();
+  return result;
+}
@@ -0,0 +1,522 @@
+#include "adt_edit_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+#include "adt.h"
+#include "fmt/core.h"
+#include "utils.h"
+
+using Error = AdtModder::Error;
+using Ditto::Result;
+
+namespace {
+
+bool PropertyNameEquals(const adt_property *prop, std::string_view name) {
+  return strnlen(prop->name, sizeof(prop->name)) == name.size() &&
+         memcmp(prop->name, name.data(), name.size()) == 0;
+}
+
+// A structural edit of the original ADT, in the order it is applied by Emit()
+struct Edit {
+  enum class Kind {
+    AddedProperties,
+    AddedChildren,
+    Header,
+    DeletedProperty,
+  };
+
+  uint32_t offset;
+  uint32_t removed;
+  uint32_t depth;
+  Kind kind;
+  const void *source;
+  adt_node_hdr header;
+
+  // Insertions go before replacements at the same offset. Between
+  // insertions, deeper nodes go first, since their subtree ends before the
+  // one of their ancestors, and added properties go before added children.
+  bool operator<(const Edit &other) const {
+    const bool insertion = kind <= Kind::AddedChildren;
+    const bool other_insertion = other.kind <= Kind::AddedChildren;
+    return std::tuple(offset, !insertion, other.depth, kind) <
+           std::tuple(other.offset, !other_insertion, depth, other.kind);
+  }
+};
+
+} // namespace
+
+size_t AdtEditLog::PendingProperty::Size() const {
+  return sizeof(adt_property) +
+         utils::roundUpToAlignment(value.size(), ADT_ALIGN);
+}
+
+uint8_t *AdtEditLog::PendingProperty::Serialize(uint8_t *out) const {
+  const size_t size = Size();
+  memset(out, 0, size);
+
+  auto *prop = reinterpret_cast<adt_property *>(out);
+  memcpy(prop->name, name.data(), name.size());
+  prop->size = value.size();
+  memcpy(&prop->value[0], value.data(), value.size());
+  return out + size;
+}
+
+size_t AdtEditLog::PendingNode::Size() const {
+  size_t size = sizeof(adt_node_hdr);
+  for (const auto &prop : properties) {
+    size += prop.Size();
+  }
+  for (const auto &child : children) {
+    size += child->Size();
+  }
+  return size;
+}
+
+uint8_t *AdtEditLog::PendingNode::Serialize(uint8_t *out) const {
+  auto *hdr = reinterpret_cast<adt_node_hdr *>(out);
+  hdr->property_count = properties.size();
+  hdr->child_count = children.size();
+  out += sizeof(adt_node_hdr);
+
+  for (const auto &prop : properties) {
+    out = prop.Serialize(out);
+  }
+  for (const auto &child : children) {
+    out = child->Serialize(out);
+  }
+  return out;
+}
+
+Result<AdtEditLog, Error>
+AdtEditLog::Create(Ditto::span<uint8_t> adt) noexcept {
+  auto index = AdtIndex::Build(adt);
+  if (index.is_error()) {
+    fmt::print("AdtModder: Unable to index the ADT, it is malformed\n");
+    return Error::MalformedAdt;
+  }
+  return AdtEditLog{adt, std::move(index.ok_value())};
+}
+
+AdtEditLog::PendingProperty *
+AdtEditLog::FindPendingProperty(std::vector<PendingProperty> &props,
+                                std::string_view name) {
+  for (auto &prop : props) {
+    if (prop.name == name) {
+      return &prop;
+    }
+  }
+  return nullptr;
+}
+
+AdtEditLog::PendingNode *AdtEditLog::FindPendingChild(AdtModder::Node parent,
+                                                      std::string_view name) {
+  std::vector<std::unique_ptr<PendingNode>> *children = nullptr;
+  if (PendingNode *pending = Pending(parent); pending != nullptr) {
+    children = &pending->children;
+  } else if (auto it = m_edits.find(parent.offset); it != m_edits.end()) {
+    children = &it->second.added_children;
+  } else {
+    return nullptr;
+  }
+
+  for (auto &child : *children) {
+    PendingProperty *node_name = FindPendingProperty(child->properties, "name");
+    if (node_name != nullptr &&
+        AdtIndex::NodeNameEquals(
+            reinterpret_cast<const char *>(node_name->value.data()),
+            node_name->value.size(), name)) {
+      return child.get();
+    }
+  }
+  return nullptr;
+}
+
+uint32_t AdtEditLog::FindOriginalChild(uint32_t parent,
+                                       std::string_view name) {
+  if (m_renamed.empty()) {
+    return m_index.ChildIndex(m_adt.data(), parent, name);
+  }
+
+  const uint32_t end = parent + m_index[parent].subtree_size;
+  for (uint32_t child = parent + 1; child < end;
+       child += m_index[child].subtree_size) {
+    const uint32_t offset = m_index[child].offset;
+    const char *node_name = nullptr;
+    size_t node_name_size = 0;
+    if (!m_renamed.contains(offset)) {
+      if (m_index[child].name != AdtIndex::kNone) {
+        node_name =
+            reinterpret_cast<const char *>(&m_adt[m_index[child].name]);
+        node_name_size = m_index[child].name_size;
+      }
+    } else if (const int prop = FindOriginalProperty(offset, "name");
+               prop >= 0) {
+      // Added properties go after the original ones
+      const auto *original = ADT_PROP(m_adt.data(), prop);
+      node_name = reinterpret_cast<const char *>(&original->value[0]);
+      node_name_size = ADT_SIZE(original);
+    } else if (auto it = m_edits.find(offset); it != m_edits.end()) {
+      const PendingProperty *added =
+          FindPendingProperty(it->second.added_properties, "name");
+      if (added != nullptr) {
+        node_name = reinterpret_cast<const char *>(added->value.data());
+        node_name_size = added->value.size();
+      }
+    }
+
+    if (node_name != nullptr &&
+        AdtIndex::NodeNameEquals(node_name, node_name_size, name)) {
+      return child;
+    }
+  }
+  return AdtIndex::kNone;
+}
+
+void AdtEditLog::OnRename(AdtModder::Node node) {
+  if (Pending(node) == nullptr) {
+    m_paths.OnRename(m_index, node.offset);
+  }
+  // Added nodes may be under the renamed one
+  m_pending_paths.clear();
+}
+
+int AdtEditLog::FindOriginalProperty(uint32_t node_offset,
+                                     std::string_view name) {
+  const std::vector<uint32_t> *deleted = nullptr;
+  if (auto it = m_edits.find(node_offset); it != m_edits.end()) {
+    deleted = &it->second.deleted_properties;
+  }
+
+  // The original layout never changes, so the property index stays valid.
+  // Only when the first match was deleted is the list scanned for another one.
+  uint8_t *data = m_adt.data();
+  const int found = m_properties.Find(m_index, data, node_offset, name);
+  if (found < 0 || deleted == nullptr ||
+      std::find(deleted->cbegin(), deleted->cend(), found) ==
+          deleted->cend()) {
+    return found;
+  }
+
+  int offset = adt_first_property_offset(data, node_offset);
+  for (int i = adt_get_property_count(data, node_offset); i > 0; i--) {
+    if (PropertyNameEquals(ADT_PROP(data, offset), name) &&
+        (deleted == nullptr ||
+         std::find(deleted->cbegin(), deleted->cend(), offset) ==
+             deleted->cend())) {
+      return offset;
+    }
+    offset = adt_next_property_offset(data, offset);
+  }
+  return -ADT_ERR_NOTFOUND;
+}
+
+std::optional<AdtModder::Node>
+AdtEditLog::ResolveNode(std::string_view path) {
+  // The path cache resolves paths with the names in the index, which no
+  // longer hold once a "name" property was added or deleted
+  if (m_renamed.empty()) {
+    const int offset = m_paths.Resolve(m_index, m_adt.data(), path);
+    if (offset >= 0) {
+      return AdtModder::Node{static_cast<uint32_t>(offset)};
+    }
+  }
+
+  // Not in the original ADT, it may have been added by a previous op
+  const std::string key = AdtPathCache::Normalize(path);
+  if (const auto it = m_pending_paths.find(key); it != m_pending_paths.end()) {
+    return AdtModder::Node{0, it->second};
+  }
+
+  // Walk the path mixing original and added nodes, which catches spellings
+  // of the path that differ from the one used to add the node.
+  AdtModder::Node node{};
+  size_t pos = 1;
+  while (pos < key.size()) {
+    size_t end = key.find('/', pos);
+    if (end == std::string::npos) {
+      end = key.size();
+    }
+    const std::string_view name{&key[pos], end - pos};
+    pos = end + 1;
+
+    if (Pending(node) == nullptr) {
+      const uint32_t child =
+          FindOriginalChild(m_index.Find(node.offset), name);
+      if (child != AdtIndex::kNone) {
+        node = AdtModder::Node{m_index[child].offset};
+        continue;
+      }
+    }
+
+    PendingNode *child = FindPendingChild(node, name);
+    if (child == nullptr) {
+      return std::nullopt;
+    }
+    node = AdtModder::Node{0, child};
+  }
+  return node;
+}
+
+Result<AdtModder::Node, Error> AdtEditLog::FindNode(std::string_view path) {
+  m_counters.path_lookups++;
+  const auto node = ResolveNode(path);
+  if (!node.has_value()) {
+    fmt::print("Could not find node \"{}\"\n", path);
+    return Error::NodeNotFound;
+  }
+  return *node;
+}
+
+// Original nodes keep their offset until the log is emitted
+void AdtEditLog::PinNodes(Ditto::span<const uint32_t>) {}
+
+Result<AdtModder::Node, Error> AdtEditLog::FindPinnedNode(uint32_t node) {
+  if (node >= m_index.size()) {
+    return Error::NodeNotFound;
+  }
+  return AdtModder::Node{m_index[node].offset};
+}
+
+Result<Ditto::span<uint8_t>, Error>
+AdtEditLog::FindProperty(AdtModder::Node node, std::string_view name) {
+  m_counters.property_lookups++;
+  // The value is handed out writable, so the node may be renamed through it
+  if (name == "name") {
+    OnRename(node);
+  }
+  PendingProperty *prop = nullptr;
+  if (PendingNode *pending = Pending(node); pending != nullptr) {
+    prop = FindPendingProperty(pending->properties, name);
+  } else {
+    const int offset = FindOriginalProperty(node.offset, name);
+    if (offset >= 0) {
+      auto *original = ADT_PROP(m_adt.data(), offset);
+      m_touched.push_back(
+          {static_cast<uint32_t>(offset + sizeof(adt_property)),
+           ADT_SIZE(original)});
+      return Ditto::span<uint8_t>{&original->value[0], ADT_SIZE(original)};
+    }
+
+    if (auto it = m_edits.find(node.offset); it != m_edits.end()) {
+      prop = FindPendingProperty(it->second.added_properties, name);
+    }
+  }
+
+  if (prop == nullptr) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+  return Ditto::span<uint8_t>{prop->value.data(), prop->value.size()};
+}
+
+AdtModder::Result AdtEditLog::AddNode(std::string_view path) {
+  m_counters.path_lookups += 2;
+  if (ResolveNode(path).has_value()) {
+    return Error::NodeAlreadyExists;
+  }
+
+  const auto last_node_separator_index = path.find_last_of('/');
+  const std::string_view parent_node_name =
+      path.substr(0, last_node_separator_index);
+  const std::string_view child_node_name =
+      path.substr(last_node_separator_index + 1);
+
+  const auto parent = ResolveNode(parent_node_name);
+  if (!parent.has_value()) {
+    fmt::print("Parent node does not exist: {}", parent_node_name);
+    return Error::NodeNotFound;
+  }
+
+  auto node = std::make_unique<PendingNode>();
+  PendingProperty name_prop{"name", {}};
+  name_prop.value.assign(child_node_name.cbegin(), child_node_name.cend());
+  name_prop.value.push_back('\0');
+  node->properties.push_back(std::move(name_prop));
+
+  m_final_size += node->Size();
+  m_counters.peak_adt_size =
+      std::max<uint64_t>(m_counters.peak_adt_size, m_final_size);
+  m_pending_paths.insert_or_assign(AdtPathCache::Normalize(path), node.get());
+  if (PendingNode *pending = Pending(*parent); pending != nullptr) {
+    pending->children.push_back(std::move(node));
+  } else {
+    m_edits[parent->offset].added_children.push_back(std::move(node));
+  }
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtEditLog::AddProperty(AdtModder::Node node,
+                                          std::string_view name,
+                                          Ditto::span<const uint8_t> value) {
+  if (name == "name") {
+    OnRename(node);
+    if (Pending(node) == nullptr) {
+      m_renamed.insert(node.offset);
+    }
+  }
+
+  PendingProperty prop{std::string{name}, {value.begin(), value.end()}};
+  m_final_size += prop.Size();
+  m_counters.peak_adt_size =
+      std::max<uint64_t>(m_counters.peak_adt_size, m_final_size);
+
+  if (PendingNode *pending = Pending(node); pending != nullptr) {
+    pending->properties.push_back(std::move(prop));
+  } else {
+    m_edits[node.offset].added_properties.push_back(std::move(prop));
+  }
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtEditLog::DeleteProperty(AdtModder::Node node,
+                                             std::string_view name) {
+  m_counters.property_lookups++;
+  if (name == "name") {
+    OnRename(node);
+    if (Pending(node) == nullptr) {
+      m_renamed.insert(node.offset);
+    }
+  }
+
+  std::vector<PendingProperty> *props = nullptr;
+  if (PendingNode *pending = Pending(node); pending != nullptr) {
+    props = &pending->properties;
+  } else {
+    const int offset = FindOriginalProperty(node.offset, name);
+    if (offset >= 0) {
+      m_edits[node.offset].deleted_properties.push_back(offset);
+      m_final_size -= adt_next_property_offset(m_adt.data(), offset) - offset;
+      return AdtModder::Result::ok();
+    }
+
+    if (auto it = m_edits.find(node.offset); it != m_edits.end()) {
+      props = &it->second.added_properties;
+    }
+  }
+
+  PendingProperty *prop =
+      props != nullptr ? FindPendingProperty(*props, name) : nullptr;
+  if (prop == nullptr) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+
+  m_final_size -= prop->Size();
+  props->erase(props->begin() + (prop - props->data()));
+  return AdtModder::Result::ok();
+}
+
+void AdtEditLog::Emit(ExtentList &out) const {
+  uint8_t *data = m_adt.data();
+
+  std::vector<Edit> edits;
+  for (const auto &[node_offset, node_edits] : m_edits) {
+    const uint32_t node = m_index.Find(node_offset);
+    const AdtIndex::Node &entry = m_index[node];
+
+    uint32_t depth = 0;
+    for (uint32_t i = entry.parent; i != AdtIndex::kNone;
+         i = m_index[i].parent) {
+      depth++;
+    }
+
+    const auto *hdr = ADT_NODE(data, node_offset);
+    const adt_node_hdr header{
+        static_cast<u32>(hdr->property_count +
+                         node_edits.added_properties.size() -
+                         node_edits.deleted_properties.size()),
+        static_cast<u32>(hdr->child_count +
+                         node_edits.added_children.size())};
+    if (header.property_count != hdr->property_count ||
+        header.child_count != hdr->child_count) {
+      edits.push_back({node_offset, sizeof(adt_node_hdr), depth,
+                       Edit::Kind::Header, nullptr, header});
+    }
+
+    for (const uint32_t offset : node_edits.deleted_properties) {
+      const uint32_t size = adt_next_property_offset(data, offset) - offset;
+      edits.push_back(
+          {offset, size, depth, Edit::Kind::DeletedProperty, nullptr, {}});
+    }
+
+    if (!node_edits.added_properties.empty()) {
+      edits.push_back({entry.first_child, 0, depth,
+                       Edit::Kind::AddedProperties, &node_edits, {}});
+    }
+    if (!node_edits.added_children.empty()) {
+      edits.push_back({entry.end, 0, depth, Edit::Kind::AddedChildren,
+                       &node_edits, {}});
+    }
+  }
+  std::sort(edits.begin(), edits.end());
+
+  size_t cursor = 0;
+  for (const Edit &edit : edits) {
+    out.AddInput(cursor, edit.offset - cursor);
+    cursor = edit.offset + edit.removed;
+
+    const auto *node_edits = static_cast<const NodeEdits *>(edit.source);
+    switch (edit.kind) {
+    case Edit::Kind::Header:
+      memcpy(out.AddBytes(sizeof(edit.header)), &edit.header,
+             sizeof(edit.header));
+      break;
+    case Edit::Kind::DeletedProperty:
+      break;
+    case Edit::Kind::AddedProperties: {
+      size_t size = 0;
+      for (const auto &prop : node_edits->added_properties) {
+        size += prop.Size();
+      }
+      uint8_t *dst = out.AddBytes(size);
+      for (const auto &prop : node_edits->added_properties) {
+        dst = prop.Serialize(dst);
+      }
+      break;
+    }
+    case Edit::Kind::AddedChildren: {
+      size_t size = 0;
+      for (const auto &child : node_edits->added_children) {
+        size += child->Size();
+      }
+      uint8_t *dst = out.AddBytes(size);
+      for (const auto &child : node_edits->added_children) {
+        dst = child->Serialize(dst);
+      }
+      break;
+    }
+    }
+  }
+  out.AddInput(cursor, m_adt.size() - cursor);
+}
+
+void AdtEditLog::Emit(Ditto::span<uint8_t> out) const {
+  ExtentList extents{Ditto::span<const uint8_t>{m_adt.data(), m_adt.size()},
+                     {}};
+  Emit(extents);
+  extents.CopyTo(out);
+}
+
+std::vector<AdtModder::Range> AdtEditLog::TouchedRanges() const {
+  std::vector<AdtModder::Range> touched = m_touched;
+  std::sort(touched.begin(), touched.end(),
+            [](const AdtModder::Range &a, const AdtModder::Range &b) {
+              return a.offset < b.offset;
+            });
+
+  // Merge overlapping and adjacent ranges
+  std::vector<AdtModder::Range> merged;
+  for (const AdtModder::Range &range : touched) {
+    if (!merged.empty() &&
+        merged.back().offset + merged.back().size >= range.offset) {
+      AdtModder::Range &last = merged.back();
+      last.size = std::max(last.offset + last.size, range.offset + range.size) -
+                  last.offset;
+    } else {
+      merged.push_back(range);
+    }
+  }
+  return merged;
+}
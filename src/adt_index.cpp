@@ -0,0 +1,364 @@
+#include "adt_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "adt.h"
+#include "utils.h"
+
+using Ditto::Result;
+
+namespace {
+
+struct OpenNode {
+  uint32_t index;
+  uint32_t remaining_children;
+};
+
+} // namespace
+
+Result<AdtIndex, AdtIndex::Error> AdtIndex::Build(Ditto::span<uint8_t> adt) {
+  if (adt.size() >= kNone) {
+    return Error::TooLarge;
+  }
+
+  const uint8_t *data = adt.data();
+  const size_t size = adt.size();
+
+  AdtIndex index;
+  std::vector<OpenNode> stack;
+  size_t offset = 0;
+
+  do {
+    if ((offset % ADT_ALIGN) != 0) {
+      return Error::Misaligned;
+    }
+    if (offset + sizeof(adt_node_hdr) > size) {
+      return Error::OutOfBounds;
+    }
+
+    const auto *hdr = reinterpret_cast<const adt_node_hdr *>(&data[offset]);
+    Entry node{};
+    node.offset = offset;
+    node.parent = stack.empty() ? kNone : stack.back().index;
+    node.name = kNone;
+
+    offset += sizeof(adt_node_hdr);
+    for (uint32_t i = 0; i < hdr->property_count; i++) {
+      if (offset + sizeof(adt_property) > size) {
+        return Error::OutOfBounds;
+      }
+      const auto *prop = reinterpret_cast<const adt_property *>(&data[offset]);
+      const size_t value_offset = offset + sizeof(adt_property);
+      const size_t next =
+          value_offset + utils::roundUpToAlignment(ADT_SIZE(prop), ADT_ALIGN);
+      if (next > size) {
+        return Error::OutOfBounds;
+      }
+      if (node.name == kNone && strncmp(prop->name, "name", 32) == 0) {
+        node.name = value_offset - node.offset;
+        node.name_size = ADT_SIZE(prop);
+      }
+      offset = next;
+    }
+    node.properties_size = offset - node.offset - sizeof(adt_node_hdr);
+
+    const uint32_t node_index = index.m_nodes.size();
+    index.m_nodes.push_back(node);
+
+    if (hdr->child_count != 0) {
+      stack.push_back({node_index, hdr->child_count});
+      continue;
+    }
+
+    // Leaf node, close it and every ancestor whose last child this was
+    index.m_nodes[node_index].subtree_size = 1;
+    while (!stack.empty() && --stack.back().remaining_children == 0) {
+      Entry &parent = index.m_nodes[stack.back().index];
+      parent.subtree_size = index.m_nodes.size() - stack.back().index;
+      stack.pop_back();
+    }
+  } while (!stack.empty());
+
+  index.m_end = offset;
+  index.m_shifts.resize(index.m_nodes.size() + 1);
+  return index;
+}
+
+AdtIndex::Node AdtIndex::operator[](size_t index) const {
+  const Entry &entry = m_nodes[index];
+  const uint32_t offset = Offset(index);
+  Node node;
+  node.offset = offset;
+  node.parent = entry.parent;
+  node.first_property = offset + sizeof(adt_node_hdr);
+  node.first_child = node.first_property + entry.properties_size;
+  node.end = End(index);
+  node.subtree_size = entry.subtree_size;
+  node.name = entry.name == kNone ? kNone : offset + entry.name;
+  node.name_size = entry.name_size;
+  return node;
+}
+
+uint32_t AdtIndex::Offset(uint32_t index) const {
+  int64_t offset = m_nodes[index].offset;
+  if (m_shifted) {
+    for (size_t i = index + 1; i > 0; i -= i & -i) {
+      offset += m_shifts[i];
+    }
+  }
+  return static_cast<uint32_t>(offset);
+}
+
+uint32_t AdtIndex::End(uint32_t index) const {
+  // Nodes are contiguous, so the subtree ends where the next node starts
+  const size_t next = index + m_nodes[index].subtree_size;
+  return next < m_nodes.size() ? Offset(next) : m_end;
+}
+
+void AdtIndex::Shift(uint32_t index, int64_t delta) {
+  for (size_t i = index + 1; i < m_shifts.size(); i += i & -i) {
+    m_shifts[i] += delta;
+  }
+  m_shifted = true;
+}
+
+std::string_view AdtIndex::Name(const uint8_t *adt, uint32_t index) const {
+  const Entry &node = m_nodes[index];
+  if (node.name == kNone) {
+    return {};
+  }
+  const char *name =
+      reinterpret_cast<const char *>(&adt[Offset(index) + node.name]);
+  return {name, strnlen(name, node.name_size)};
+}
+
+std::string AdtIndex::Path(const uint8_t *adt, uint32_t index) const {
+  if (m_nodes[index].parent == kNone) {
+    return "/";
+  }
+
+  std::vector<std::string_view> names;
+  for (; m_nodes[index].parent != kNone; index = m_nodes[index].parent) {
+    names.push_back(Name(adt, index));
+  }
+  std::string path;
+  for (auto it = names.rbegin(); it != names.rend(); ++it) {
+    path.push_back('/');
+    path.append(*it);
+  }
+  return path;
+}
+
+uint32_t AdtIndex::Find(int offset) const {
+  uint32_t low = 0;
+  uint32_t high = m_nodes.size();
+  while (low < high) {
+    const uint32_t middle = low + (high - low) / 2;
+    if (static_cast<int64_t>(Offset(middle)) < offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == m_nodes.size() || static_cast<int>(Offset(low)) != offset) {
+    return kNone;
+  }
+  return low;
+}
+
+int AdtIndex::FirstChildOffset(int offset) const {
+  const uint32_t index = Find(offset);
+  if (index == kNone) {
+    return -ADT_ERR_BADOFFSET;
+  }
+  return offset + sizeof(adt_node_hdr) + m_nodes[index].properties_size;
+}
+
+int AdtIndex::NextSiblingOffset(int offset) const {
+  const uint32_t index = Find(offset);
+  if (index == kNone) {
+    return -ADT_ERR_BADOFFSET;
+  }
+  return End(index);
+}
+
+bool AdtIndex::NodeNameEquals(const char *node_name, size_t node_name_size,
+                              std::string_view name) {
+  if (node_name_size <= name.size() ||
+      memcmp(node_name, name.data(), name.size()) != 0) {
+    return false;
+  }
+
+  const char terminator = node_name[name.size()];
+  if (terminator == '\0') {
+    return true;
+  }
+  return terminator == '@' && name.find('@') == std::string_view::npos;
+}
+
+uint32_t AdtIndex::ChildIndex(const uint8_t *adt, uint32_t parent,
+                              std::string_view name) const {
+  const uint32_t end = parent + m_nodes[parent].subtree_size;
+  for (uint32_t child = parent + 1; child < end;
+       child += m_nodes[child].subtree_size) {
+    const Entry &node = m_nodes[child];
+    if (node.name == kNone) {
+      continue;
+    }
+    const uint32_t name_offset = Offset(child) + node.name;
+    if (NodeNameEquals(reinterpret_cast<const char *>(&adt[name_offset]),
+                       node.name_size, name)) {
+      return child;
+    }
+  }
+
+  return kNone;
+}
+
+int AdtIndex::SubnodeOffset(const uint8_t *adt, int parent_offset,
+                            std::string_view name) const {
+  const uint32_t parent = Find(parent_offset);
+  if (parent == kNone) {
+    return -ADT_ERR_BADOFFSET;
+  }
+
+  const uint32_t child = ChildIndex(adt, parent, name);
+  if (child == kNone) {
+    return -ADT_ERR_NOTFOUND;
+  }
+  return Offset(child);
+}
+
+int AdtIndex::PathOffset(const uint8_t *adt, std::string_view path) const {
+  if (m_nodes.empty()) {
+    return -ADT_ERR_BADOFFSET;
+  }
+
+  uint32_t node = 0;
+  size_t pos = 0;
+  while (pos < path.size()) {
+    while (pos < path.size() && path[pos] == '/') {
+      pos++;
+    }
+    if (pos == path.size()) {
+      break;
+    }
+
+    size_t end = path.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+
+    node = ChildIndex(adt, node, path.substr(pos, end - pos));
+    if (node == kNone) {
+      return -ADT_ERR_NOTFOUND;
+    }
+    pos = end;
+  }
+
+  return Offset(node);
+}
+
+void AdtIndex::FindName(const uint8_t *adt, uint32_t index) {
+  Entry &node = m_nodes[index];
+  node.name = kNone;
+  node.name_size = 0;
+
+  const uint32_t node_offset = Offset(index);
+  const auto *hdr = reinterpret_cast<const adt_node_hdr *>(&adt[node_offset]);
+  uint32_t offset = node_offset + sizeof(adt_node_hdr);
+  for (uint32_t i = 0; i < hdr->property_count; i++) {
+    const auto *prop = reinterpret_cast<const adt_property *>(&adt[offset]);
+    if (strncmp(prop->name, "name", 32) == 0) {
+      node.name = offset + sizeof(adt_property) - node_offset;
+      node.name_size = ADT_SIZE(prop);
+      return;
+    }
+    offset += sizeof(adt_property) +
+              utils::roundUpToAlignment(ADT_SIZE(prop), ADT_ALIGN);
+  }
+}
+
+void AdtIndex::OnPropertyAdded(const uint8_t *adt, uint32_t node_offset,
+                               uint32_t offset, uint32_t size) {
+  const uint32_t target = Find(node_offset);
+  if (target == kNone) {
+    return;
+  }
+
+  // Only the node itself grows, everything after it moves
+  Entry &node = m_nodes[target];
+  node.properties_size += size;
+  if (node.name != kNone && node_offset + node.name >= offset) {
+    node.name += size;
+  }
+  Shift(target + 1, size);
+  m_end += size;
+
+  if (node.name == kNone) {
+    FindName(adt, target);
+  }
+}
+
+void AdtIndex::OnPropertyRemoved(const uint8_t *adt, uint32_t node_offset,
+                                 uint32_t offset, uint32_t size) {
+  const uint32_t target = Find(node_offset);
+  if (target == kNone) {
+    return;
+  }
+
+  Entry &node = m_nodes[target];
+  node.properties_size -= size;
+  Shift(target + 1, -static_cast<int64_t>(size));
+  m_end -= size;
+
+  if (node.name == kNone) {
+    return;
+  }
+  const uint32_t name = node_offset + node.name;
+  if (name >= offset + size) {
+    node.name -= size;
+  } else if (name >= offset) {
+    FindName(adt, target);
+  }
+}
+
+void AdtIndex::OnNodeAdded(const uint8_t *adt, uint32_t parent_offset,
+                           uint32_t offset, uint32_t size) {
+  const uint32_t parent = Find(parent_offset);
+  if (parent == kNone) {
+    return;
+  }
+
+  // The new node becomes the last child of the parent. The entries after it
+  // move, so the shifts are applied to every offset and start over.
+  const uint32_t position = parent + m_nodes[parent].subtree_size;
+  if (m_shifted) {
+    for (uint32_t i = 0; i < m_nodes.size(); i++) {
+      m_nodes[i].offset = Offset(i);
+    }
+    std::fill(m_shifts.begin(), m_shifts.end(), 0);
+    m_shifted = false;
+  }
+  for (uint32_t i = position; i < m_nodes.size(); i++) {
+    Entry &node = m_nodes[i];
+    node.offset += size;
+    if (node.parent != kNone && node.parent >= position) {
+      node.parent++;
+    }
+  }
+  for (uint32_t i = parent; i != kNone; i = m_nodes[i].parent) {
+    m_nodes[i].subtree_size++;
+  }
+  m_end += size;
+
+  Entry node{};
+  node.offset = offset;
+  node.parent = parent;
+  node.subtree_size = 1;
+  node.properties_size = size - sizeof(adt_node_hdr);
+  m_nodes.insert(m_nodes.begin() + position, node);
+  m_shifts.push_back(0);
+  FindName(adt, position);
+}
@@ -1,105 +1,645 @@
 #include "adt_modder.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
 
+#include "adt_blob_editor.h"
+#include "adt_edit_log.h"
+#include "adt_index.h"
+#include "adt_tree_editor.h"
 #include "fmt/core.h"
+#include "op_plan.h"
+#include "run_stats.h"
 
-std::unordered_map<std::string, AdtModder::Op *> &GetOperations() {
-  static std::unordered_map<std::string, AdtModder::Op *> ops;
-  return ops;
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t ElapsedNs(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              start)
+      .count();
+}
+
+// Work done between two snapshots of the counters of an editor
+AdtModder::Counters Delta(const AdtModder::Counters &before,
+                          const AdtModder::Counters &after) {
+  return {after.path_lookups - before.path_lookups,
+          after.property_lookups - before.property_lookups,
+          after.bytes_moved - before.bytes_moved,
+          after.reallocations - before.reallocations, after.peak_adt_size};
 }
 
+// Returns `plan`, or a copy of it in `expanded` with its selectors expanded
+// against `adt`
+Ditto::Result<const OpPlan *, AdtModder::Error>
+Resolve(Ditto::span<uint8_t> adt, const OpPlan &plan,
+        std::optional<OpPlan> &expanded) {
+  if (!plan.HasSelectors()) {
+    return &plan;
+  }
+  expanded.emplace(DITTO_PROPAGATE(plan.Expand(adt)));
+  return &*expanded;
+}
+
+// Returns the node the op at `index` is pinned to, or AdtIndex::kNone
+uint32_t PinOf(const OpPlan &plan, size_t index) {
+  return plan.Pins().empty() ? AdtIndex::kNone : plan.Pins()[index];
+}
+
+// Serves the pre-resolved node of a single op, and optionally its target,
+// forwarding anything else to the actual editor
+class PinnedEditor : public AdtModder::Editor {
+public:
+  PinnedEditor(AdtModder::Editor &editor, AdtModder::Node node)
+      : m_editor(editor), m_node(node) {}
+  PinnedEditor(AdtModder::Editor &editor,
+               std::optional<AdtModder::Node> node, std::string_view property,
+               std::optional<Ditto::span<uint8_t>> value)
+      : m_editor(editor), m_node(node), m_property(property), m_value(value) {
+  }
+
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindNode(std::string_view) override {
+    if (!m_node.has_value()) {
+      return AdtModder::Error::NodeNotFound;
+    }
+    return *m_node;
+  }
+  void PinNodes(Ditto::span<const uint32_t> nodes) override {
+    m_editor.PinNodes(nodes);
+  }
+  Ditto::Result<AdtModder::Node, AdtModder::Error>
+  FindPinnedNode(uint32_t node) override {
+    return m_editor.FindPinnedNode(node);
+  }
+
+  Ditto::Result<Ditto::span<uint8_t>, AdtModder::Error>
+  FindProperty(AdtModder::Node node, std::string_view name) override {
+    if (!m_property.has_value() || name != *m_property) {
+      return m_editor.FindProperty(node, name);
+    }
+    if (!m_value.has_value()) {
+      return AdtModder::Error::PropertyNotFound;
+    }
+    return *m_value;
+  }
+
+  AdtModder::Result AddNode(std::string_view path) override {
+    return m_editor.AddNode(path);
+  }
+  AdtModder::Result AddProperty(AdtModder::Node node, std::string_view name,
+                                Ditto::span<const uint8_t> value) override {
+    return m_editor.AddProperty(node, name, value);
+  }
+  AdtModder::Result DeleteProperty(AdtModder::Node node,
+                                   std::string_view name) override {
+    return m_editor.DeleteProperty(node, name);
+  }
+
+  const AdtModder::Counters &GetCounters() const override {
+    return m_editor.GetCounters();
+  }
+
+private:
+  AdtModder::Editor &m_editor;
+  std::optional<AdtModder::Node> m_node;
+  std::optional<std::string_view> m_property;
+  std::optional<Ditto::span<uint8_t>> m_value;
+};
+
+// Parses a decimal or "0x" prefixed hexadecimal number no larger than `max`.
+// Anything but the digits, the empty string included, is rejected, where
+// strtoull() would skip spaces, take a sign or stop at the first non-digit.
+std::optional<uint64_t> ParseNumber(const std::string &string, uint64_t max) {
+  const bool hex = string.starts_with("0x");
+  const std::string_view digits =
+      std::string_view{string}.substr(hex ? 2 : 0);
+  if (digits.empty() ||
+      !std::all_of(digits.begin(), digits.end(), [hex](char c) {
+        return hex ? std::isxdigit(static_cast<unsigned char>(c)) != 0
+                   : std::isdigit(static_cast<unsigned char>(c)) != 0;
+      })) {
+    return std::nullopt;
+  }
+
+  errno = 0;
+  char *end;
+  const unsigned long long value =
+      std::strtoull(digits.data(), &end, hex ? 16 : 10);
+  if (errno != 0 || end != digits.data() + digits.size() || value > max) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+} // namespace
+
 AdtModder::Result
 AdtModder::RunFromJson(AdtModder::Adt adt_data,
                        const nlohmann::json &op_array) noexcept {
-  if (!op_array.is_array()) {
-    fmt::print("AdtModder: Expected a json array.\n");
-    return Error::MalformedJson;
+  const auto plan = DITTO_PROPAGATE(OpPlan::Compile(op_array));
+  return Run(adt_data, plan);
+}
+
+AdtModder::Result AdtModder::Run(AdtModder::Adt adt_data,
+                                 const OpPlan &plan) noexcept {
+  std::optional<OpPlan> expanded;
+  const OpPlan *run_plan = DITTO_PROPAGATE(
+      Resolve({adt_data.data(), adt_data.size()}, plan, expanded));
+
+  if (m_mode == Mode::Immediate) {
+    auto editor = DITTO_PROPAGATE(AdtBlobEditor::Create(adt_data));
+    return RunOps(editor, *run_plan);
   }
 
-  auto &ops = GetOperations();
-  for (auto &element : op_array) {
-    if (!element.is_object()) {
-      fmt::print("AdtModder: Expected a json object.\n");
-      return Error::MalformedJson;
+  if (m_mode == Mode::Tree) {
+    auto editor = DITTO_PROPAGATE(AdtTreeEditor::Create(adt_data));
+    auto result = RunOps(editor, *run_plan);
+    if (result.is_error()) {
+      return result;
     }
 
-    if (!element.contains("name")) {
-      fmt::print("All operation objects should have a \"name\" property\n");
-      return Error::MalformedJson;
+    std::vector<uint8_t> serialized(editor.Tree().Size());
+    editor.Tree().Serialize(serialized);
+    adt_data.swap(serialized);
+    return AdtModder::Result::ok();
+  }
+
+  auto log = DITTO_PROPAGATE(AdtEditLog::Create(adt_data));
+  auto result = RunOps(log, *run_plan);
+  if (result.is_error()) {
+    return result;
+  }
+
+  if (!log.IsInPlace()) {
+    std::vector<uint8_t> edited(log.FinalSize());
+    log.Emit(edited);
+    adt_data.swap(edited);
+  }
+  return AdtModder::Result::ok();
+}
+
+Ditto::Result<ExtentList, AdtModder::Error>
+AdtModder::RunToExtents(Ditto::span<uint8_t> adt,
+                        const OpPlan &plan) noexcept {
+  std::optional<OpPlan> expanded;
+  const OpPlan *run_plan = DITTO_PROPAGATE(Resolve(adt, plan, expanded));
+
+  const Ditto::span<const uint8_t> input{adt.data(), adt.size()};
+  switch (m_mode) {
+  case Mode::Immediate: {
+    std::vector<uint8_t> edited{adt.begin(), adt.end()};
+    auto editor = DITTO_PROPAGATE(AdtBlobEditor::Create(edited));
+    auto result = RunOps(editor, *run_plan);
+    if (result.is_error()) {
+      return result.error_value();
     }
 
-    std::string name = element["name"].get<std::string>();
-    fmt::print("AdtModder: Running op with name: {}\n", name);
+    ExtentList extents{input, {}};
+    extents.AddBuffer(std::move(edited));
+    return extents;
+  }
+  case Mode::Tree: {
+    auto editor = DITTO_PROPAGATE(AdtTreeEditor::Create(adt));
+    auto result = RunOps(editor, *run_plan);
+    if (result.is_error()) {
+      return result.error_value();
+    }
 
-    // Find operation
-    const auto op = ops.find(name);
-    if (op == ops.cend()) {
-      fmt::print("AdtModder: Unknown operation with name: \"{}\"\n", name);
-      return Error::InvalidOperation;
+    ExtentList extents{input, {}};
+    const size_t size = editor.Tree().Size();
+    editor.Tree().Serialize({extents.AddBytes(size), size});
+    return extents;
+  }
+  case Mode::EditLog:
+    break;
+  }
+
+  auto log = DITTO_PROPAGATE(AdtEditLog::Create(adt));
+  auto result = RunOps(log, *run_plan);
+  if (result.is_error()) {
+    return result.error_value();
+  }
+
+  // Values of the original properties may have been modified in memory
+  std::vector<ExtentList::Range> modified;
+  for (const Range &range : log.TouchedRanges()) {
+    modified.push_back({range.offset, range.size});
+  }
+
+  ExtentList extents{input, std::move(modified)};
+  if (log.IsInPlace()) {
+    extents.AddInput(0, adt.size());
+  } else {
+    log.Emit(extents);
+  }
+  return extents;
+}
+
+Ditto::Result<std::vector<AdtModder::Range>, AdtModder::Error>
+AdtModder::RunInPlace(Ditto::span<uint8_t> adt,
+                      const OpPlan &plan) noexcept {
+  if (!plan.PreservesLayout()) {
+    fmt::print("AdtModder: The operations modify the layout of the ADT\n");
+    return Error::InvalidOperation;
+  }
+
+  std::optional<OpPlan> expanded;
+  const OpPlan *run_plan = DITTO_PROPAGATE(Resolve(adt, plan, expanded));
+
+  // With no structural edits, the edit log never touches the layout
+  auto log = DITTO_PROPAGATE(AdtEditLog::Create(adt));
+  auto result = RunOps(log, *run_plan);
+  if (result.is_error()) {
+    return result.error_value();
+  }
+
+  return log.TouchedRanges();
+}
+
+AdtModder::Result AdtModder::RunToBuffer(Ditto::span<const uint8_t> adt,
+                                         const OpPlan &plan,
+                                         Ditto::span<uint8_t> out,
+                                         size_t &size) noexcept {
+  // Layout-preserving plans edit the output directly
+  if (plan.PreservesLayout()) {
+    size = adt.size();
+    if (out.size() < size) {
+      return Error::OutputTooSmall;
+    }
+    if (out.data() != adt.data()) {
+      memcpy(out.data(), adt.data(), size);
+    }
+    auto touched = RunInPlace({out.data(), size}, plan);
+    if (touched.is_error()) {
+      return touched.error_value();
+    }
+    return AdtModder::Result::ok();
+  }
+
+  // The extents reference the input, which the ops also write to, so they
+  // run on a copy
+  std::vector<uint8_t> work{adt.begin(), adt.end()};
+  auto extents = DITTO_PROPAGATE(RunToExtents(work, plan));
+  size = extents.Size();
+  if (out.size() < size) {
+    return Error::OutputTooSmall;
+  }
+  extents.CopyTo({out.data(), size});
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtModder::RunOps(Editor &editor,
+                                    const OpPlan &plan) noexcept {
+  std::vector<uint32_t> pinned;
+  for (const uint32_t node : plan.Pins()) {
+    if (node != AdtIndex::kNone) {
+      pinned.push_back(node);
+    }
+  }
+  if (!pinned.empty()) {
+    editor.PinNodes({pinned.data(), pinned.size()});
+  }
+
+  if (m_stats == nullptr) {
+    return RunSegments(editor, plan);
+  }
+
+  RunStats run;
+  run.runs = 1;
+  for (const auto &op : plan.Ops()) {
+    RunStats::Op &op_stats = run.ops.emplace_back();
+    op_stats.name = OpPlan::Name(op);
+    op_stats.node = std::visit([](const auto &op) { return op.node; }, op);
+  }
+
+  const auto start = Clock::now();
+  m_run = &run;
+  auto result = RunSegments(editor, plan);
+  m_run = nullptr;
+  run.wall_ns = ElapsedNs(start);
+  run.totals = editor.GetCounters();
+
+  m_stats->Merge(run);
+  return result;
+}
+
+AdtModder::Result AdtModder::RunSegments(Editor &editor,
+                                           const OpPlan &plan) noexcept {
+  // Runs of consecutive ops with a target are fused, anything else runs on
+  // its own, in order. Ops on "name" may rename their node, and fused ops
+  // resolve their nodes up front, so those are never fused.
+  const auto fusable = [](const OpPlan::Op &op) {
+    const auto target = OpPlan::GetTarget(op);
+    return target.has_value() && target->property != "name";
+  };
+  const auto &ops = plan.Ops();
+  size_t begin = 0;
+  while (begin < ops.size()) {
+    size_t end = begin;
+    while (end < ops.size() && fusable(ops[end])) {
+      end++;
     }
 
-    auto result = op->second->Run(adt_data, element);
+    Result result = Result::ok();
+    if (end - begin > 1) {
+      result = RunFused(editor, plan, begin, end);
+    } else {
+      end = begin + 1;
+      const uint32_t pin = PinOf(plan, begin);
+      if (pin == AdtIndex::kNone) {
+        result = RunOp(editor, plan, begin);
+      } else {
+        auto node = editor.FindPinnedNode(pin);
+        if (node.is_error()) {
+          return node.error_value();
+        }
+        PinnedEditor pinned{editor, node.ok_value()};
+        result = RunOp(pinned, plan, begin);
+      }
+    }
+    if (result.is_error()) {
+      return result;
+    }
+    begin = end;
+  }
+
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtModder::RunOp(Editor &editor, const OpPlan &plan,
+                                   size_t index) noexcept {
+  const auto &op = plan.Ops()[index];
+  const auto name = OpPlan::Name(op);
+  if (m_verbose) {
+    fmt::print("AdtModder: Running op with name: {}\n", name);
+  }
+
+  if (m_run == nullptr) {
+    auto result = OpPlan::Run(op, editor);
     if (result.is_error()) {
       fmt::print("AdtModder: Error running operation \"{}\"\n", name);
       return result.error_value();
     }
+    return AdtModder::Result::ok();
   }
 
+  RunStats::Op &op_stats = m_run->ops[index];
+  const Counters before = editor.GetCounters();
+  const auto start = Clock::now();
+  auto result = OpPlan::Run(op, editor);
+  op_stats.wall_ns = ElapsedNs(start);
+  op_stats.counters = Delta(before, editor.GetCounters());
+  if (result.is_error()) {
+    op_stats.failures = 1;
+    fmt::print("AdtModder: Error running operation \"{}\"\n", name);
+    return result.error_value();
+  }
   return AdtModder::Result::ok();
 }
 
-std::string AdtModder::Help() const noexcept {
-  std::stringstream stream;
-  stream << "\nSupported Adt Modder commands:\n";
-  for (const auto &[name, op] : GetOperations()) {
-    stream << fmt::format("Command \"{}\": {}\n", name, op->Help());
+AdtModder::Result AdtModder::RunFused(Editor &editor, const OpPlan &plan,
+                                      size_t begin, size_t end) noexcept {
+  std::vector<Target> targets;
+  for (size_t i = begin; i < end; i++) {
+    targets.push_back(*OpPlan::GetTarget(plan.Ops()[i]));
+    if (m_run != nullptr) {
+      m_run->ops[i].fused = true;
+    }
+  }
+
+  // Resolve every distinct node once. Pinned ops are told apart from the
+  // others, as the same path may resolve to another node.
+  std::vector<std::optional<Node>> nodes;
+  std::unordered_map<std::string_view, size_t> node_slots;
+  std::unordered_map<uint32_t, size_t> pinned_slots;
+  std::vector<size_t> op_nodes(targets.size());
+  for (size_t i = 0; i < targets.size(); i++) {
+    if (const uint32_t pin = PinOf(plan, begin + i); pin != AdtIndex::kNone) {
+      auto [it, inserted] = pinned_slots.try_emplace(pin, nodes.size());
+      if (inserted) {
+        auto node = editor.FindPinnedNode(pin);
+        nodes.push_back(node.is_error() ? std::nullopt
+                                        : std::optional{node.ok_value()});
+      }
+      op_nodes[i] = it->second;
+      continue;
+    }
+
+    const std::string_view path = targets[i].node;
+    auto [it, inserted] = node_slots.try_emplace(path, nodes.size());
+    if (inserted) {
+      auto node = editor.FindNode(path);
+      nodes.push_back(node.is_error() ? std::nullopt
+                                      : std::optional{node.ok_value()});
+    }
+    op_nodes[i] = it->second;
+  }
+
+  // Look up the properties of every node in a single pass over its property
+  // list, visiting nodes in the order they have in the buffer
+  std::vector<std::vector<size_t>> node_ops(nodes.size());
+  for (size_t i = 0; i < targets.size(); i++) {
+    node_ops[op_nodes[i]].push_back(i);
   }
-  return stream.str();
+
+  std::vector<size_t> node_order(nodes.size());
+  std::iota(node_order.begin(), node_order.end(), 0);
+  std::sort(node_order.begin(), node_order.end(), [&](size_t a, size_t b) {
+    const Node node_a = nodes[a].value_or(Node{});
+    const Node node_b = nodes[b].value_or(Node{});
+    if (node_a.offset != node_b.offset) {
+      return node_a.offset < node_b.offset;
+    }
+    return std::less<void *>{}(node_a.handle, node_b.handle);
+  });
+
+  std::vector<std::optional<Ditto::span<uint8_t>>> values(targets.size());
+  std::vector<std::string_view> names;
+  std::vector<std::optional<Ditto::span<uint8_t>>> found;
+  for (const size_t slot : node_order) {
+    if (!nodes[slot].has_value()) {
+      continue;
+    }
+
+    names.clear();
+    for (const size_t op : node_ops[slot]) {
+      names.push_back(targets[op].property);
+    }
+    editor.FindProperties(*nodes[slot], {names.data(), names.size()},
+                          found);
+    for (size_t i = 0; i < names.size(); i++) {
+      values[node_ops[slot][i]] = found[i];
+    }
+  }
+
+  // Apply the ops in buffer order. Ops on the same property keep their
+  // relative order, and ops on missing targets fail first.
+  std::vector<size_t> order(targets.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    const auto position = [&](size_t op) -> const uint8_t * {
+      return values[op].has_value() ? values[op]->data() : nullptr;
+    };
+    return std::less<const uint8_t *>{}(position(a), position(b));
+  });
+
+  for (const size_t i : order) {
+    PinnedEditor pinned{editor, nodes[op_nodes[i]], targets[i].property,
+                        values[i]};
+    auto result = RunOp(pinned, plan, begin + i);
+    if (result.is_error()) {
+      return result;
+    }
+  }
+
+  return AdtModder::Result::ok();
 }
 
-bool AdtModder::RegisterOperation(std::string_view name,
-                                  Op &operation) noexcept {
-  GetOperations()[std::string{name}] = &operation;
-  return true;
+void AdtModder::Editor::FindProperties(
+    Node node, Ditto::span<const std::string_view> names,
+    std::vector<std::optional<Ditto::span<uint8_t>>> &values) {
+  values.clear();
+  for (const auto name : names) {
+    auto value = FindProperty(node, name);
+    values.push_back(value.is_error() ? std::nullopt
+                                      : std::optional{value.ok_value()});
+  }
 }
 
-Ditto::Result<uint32_t, AdtModder::Error>
-AdtModder::ParseU32(const std::string &string) {
-  int base = 10;
-  const char *ptr = string.c_str();
-  if (string.starts_with("0x")) {
-    base = 16;
-    ptr = string.c_str() + 2;
+Ditto::Result<std::string, AdtModder::Error>
+AdtModder::GetString(const nlohmann::json &command, std::string_view field) {
+  const std::string key{field};
+  if (!command.contains(key) || !command[key].is_string()) {
+    fmt::print("Unable to find {} in command\n", field);
+    return Error::InvalidOperation;
   }
+  return command[key].get<std::string>();
+}
 
-  try {
-    return std::strtoul(string.c_str(), nullptr, base);
-  } catch (std::out_of_range &e) {
-    fmt::print("Invalid u32 in string: {}, {}", string, e.what());
-    return AdtModder::Error::InvalidOperation;
-  } catch (std::invalid_argument &e) {
-    fmt::print("Invalid u32 in string: {}, {}", string, e.what());
-    return AdtModder::Error::InvalidOperation;
+Ditto::Result<AdtModder::NodeSelector, AdtModder::Error>
+AdtModder::GetNodeSelector(const nlohmann::json &command) {
+  if (!command.contains("compatible")) {
+    return NodeSelector{DITTO_PROPAGATE(GetString(command, "node")), {}};
+  }
+
+  auto compatible = DITTO_PROPAGATE(GetString(command, "compatible"));
+  if (compatible.empty()) {
+    fmt::print("The compatible string of an op can't be empty\n");
+    return Error::InvalidOperation;
   }
+  if (!command.contains("node")) {
+    return NodeSelector{"/**", std::move(compatible)};
+  }
+  return NodeSelector{DITTO_PROPAGATE(GetString(command, "node")),
+                      std::move(compatible)};
 }
 
-Ditto::Result<uint64_t, AdtModder::Error>
-AdtModder::ParseU64(const std::string &string) {
-  int base = 10;
-  const char *ptr = string.c_str();
-  if (string.starts_with("0x")) {
-    base = 16;
-    ptr = string.c_str() + 2;
+Ditto::Result<std::vector<uint8_t>, AdtModder::Error>
+AdtModder::EncodeValue(const nlohmann::json &json) {
+  std::vector<uint8_t> value;
+  if (json.is_string()) {
+    const std::string value_string = json.get<std::string>();
+    value.resize(value_string.length() + 1);
+    memcpy(value.data(), value_string.c_str(), value_string.length());
+    value[value_string.length()] = '\0';
+  } else if (json.is_object()) {
+    const auto value_object = json.get<nlohmann::json>();
+
+    if (!value_object.contains("type") || !value_object["type"].is_string()) {
+      fmt::print("Unknown value type in command\n");
+      return Error::InvalidOperation;
+    }
+
+    if (!value_object.contains("contents")) {
+      fmt::print("Unknown value contents in command\n");
+      return Error::InvalidOperation;
+    }
+
+    const auto type = value_object["type"].get<std::string>();
+
+    if (type == "u64") {
+      if (!value_object["contents"].is_string()) {
+        fmt::print("Type u64 should be a string in json\n");
+        return Error::InvalidOperation;
+      }
+      const auto contents = value_object["contents"].get<std::string>();
+      uint64_t parsed = DITTO_PROPAGATE(ParseU64(contents));
+      for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        value.push_back(parsed & 0xFF);
+        parsed >>= 8;
+      }
+    } else if (type == "u32") {
+      if (!value_object["contents"].is_string()) {
+        fmt::print("Type u32 should be a string in json\n");
+        return Error::InvalidOperation;
+      }
+      const auto contents = value_object["contents"].get<std::string>();
+      uint64_t parsed = DITTO_PROPAGATE(ParseU32(contents));
+      for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        value.push_back(parsed & 0xFF);
+        parsed >>= 8;
+      }
+    } else if (type == "u64[]") {
+      if (!value_object["contents"].is_array()) {
+        fmt::print("Type u64[] should be an array in json\n");
+        return Error::InvalidOperation;
+      }
+
+      for (nlohmann::json &content_element :
+           value_object["contents"].get<std::vector<nlohmann::json>>()) {
+        if (!content_element.is_string()) {
+          fmt::print("Expected string in u64[]\n");
+          return Error::InvalidOperation;
+        }
+
+        uint64_t parsed = DITTO_PROPAGATE(
+            ParseU64(content_element.get<std::string>()));
+        for (size_t i = 0; i < sizeof(uint64_t); i++) {
+          value.push_back(parsed & 0xFF);
+          parsed >>= 8;
+        }
+      }
+    } else {
+      fmt::print("Unknown value type in command");
+      return Error::InvalidOperation;
+    }
+  } else {
+    fmt::print("Unknown value type in command");
+    return Error::InvalidOperation;
   }
 
-  try {
-    return std::strtoull(string.c_str(), nullptr, base);
-  } catch (std::out_of_range &e) {
-    fmt::print("Invalid u64 in string: {}, {}", string, e.what());
+  return value;
+}
+
+std::string AdtModder::Help() const noexcept {
+  return "\nSupported Adt Modder commands:\n" + OpPlan::Help();
+}
+
+Ditto::Result<uint32_t, AdtModder::Error>
+AdtModder::ParseU32(const std::string &string) {
+  const auto parsed = ParseNumber(string, UINT32_MAX);
+  if (!parsed.has_value()) {
+    fmt::print("Invalid u32 in string: \"{}\"\n", string);
     return AdtModder::Error::InvalidOperation;
-  } catch (std::invalid_argument &e) {
-    fmt::print("Invalid u64 in string: {}, {}", string, e.what());
+  }
+  return static_cast<uint32_t>(*parsed);
+}
+
+Ditto::Result<uint64_t, AdtModder::Error>
+AdtModder::ParseU64(const std::string &string) {
+  const auto parsed = ParseNumber(string, UINT64_MAX);
+  if (!parsed.has_value()) {
+    fmt::print("Invalid u64 in string: \"{}\"\n", string);
     return AdtModder::Error::InvalidOperation;
   }
+  return *parsed;
 }
@@ -1,58 +1,28 @@
-
-#include "adt.h"
-#include "adt_modder.h"
-#include "fmt/core.h"
-
-class RandomizePropertyOp : public AdtModder::Op {
-public:
-  static RandomizePropertyOp &GetInstance() noexcept {
-    static RandomizePropertyOp op;
-    return op;
-  }
-
-private:
-  AdtModder::Result Run(AdtModder::Adt adt_data,
-                        const nlohmann::json &) noexcept override;
-
-  [[nodiscard]] const char *Help() const noexcept override {
-    return "Randomizes a property value in the given adt";
-  }
-
-  static bool s_initialized;
-};
-
-bool RandomizePropertyOp::s_initialized = AdtModder::RegisterOperation(
-    "randomize_property", RandomizePropertyOp::GetInstance());
+#include "adt_ops.h"
+#include "philox.h"
+#include "utils.h"
+
+Ditto::Result<RandomizePropertyOp, AdtModder::Error>
+RandomizePropertyOp::Compile(const nlohmann::json &command) noexcept {
+  auto selector = DITTO_PROPAGATE(AdtModder::GetNodeSelector(command));
+  auto property = DITTO_PROPAGATE(AdtModder::GetString(command, "property"));
+  return RandomizePropertyOp{std::move(selector.node), std::move(property),
+                             std::move(selector.compatible)};
+}
 
 AdtModder::Result
-RandomizePropertyOp::Run(AdtModder::Adt adt_data,
-                         const nlohmann::json &command) noexcept {
-  if (!command.contains("node") || !command["node"].is_string()) {
-    fmt::print("Unable to find node in command\n");
-    return AdtModder::Error::InvalidOperation;
-  }
-  if (!command.contains("property") || !command["property"].is_string()) {
-    fmt::print("Unable to find property in command\n");
-    return AdtModder::Error::InvalidOperation;
-  }
-  const std::string node = command["node"].get<std::string>();
-  const std::string prop_name = command["property"].get<std::string>();
-
-  uint8_t *data = adt_data.data();
-  int node_offset = adt_path_offset(data, node.c_str());
-  if (node_offset < 0) {
-    fmt::print("Could not look find node \"{}\"\n", node.c_str());
-    return AdtModder::Error::NodeNotFound;
-  }
-  auto *prop = adt_get_property(data, node_offset, prop_name.c_str());
-  if (prop == nullptr) {
-    fmt::print("Could not look find node \"{}\", prop \"{}\"\n", node,
-               prop_name);
-    return AdtModder::Error::PropertyNotFound;
-  }
-
-  for (size_t i = 0; i < prop->size; i++) {
-    prop->value[i] = rand();
-  }
+RandomizePropertyOp::Run(AdtModder::Editor &editor) const noexcept {
+  const auto node_handle = DITTO_PROPAGATE(editor.FindNode(node));
+  auto value = DITTO_PROPAGATE(editor.FindProperty(node_handle, property));
+
+  // Every property gets its own stream, keyed on the seed and its location.
+  // The terminator of the node path separates it from the property name.
+  uint64_t key = utils::hashBytes(reinterpret_cast<const uint8_t *>(&seed),
+                                  sizeof(seed));
+  key = utils::hashBytes(reinterpret_cast<const uint8_t *>(node.data()),
+                         node.size() + 1, key);
+  key = utils::hashBytes(reinterpret_cast<const uint8_t *>(property.data()),
+                         property.size(), key);
+  Philox{key}.Fill(value);
   return AdtModder::Result::ok();
 }
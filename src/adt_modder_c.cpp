@@ -0,0 +1,113 @@
+#include "adt_modder_c.h"
+
+#include "adt_modder.h"
+#include "op_plan.h"
+
+struct adt_modder_plan {
+  OpPlan plan;
+};
+
+namespace {
+
+// Spelled out so the C values stay stable whatever the order of the enum
+int ToC(AdtModder::Error error) {
+  switch (error) {
+  case AdtModder::Error::MalformedJson:
+    return ADT_MODDER_ERR_MALFORMED_JSON;
+  case AdtModder::Error::InvalidOperation:
+    return ADT_MODDER_ERR_INVALID_OPERATION;
+  case AdtModder::Error::NodeNotFound:
+    return ADT_MODDER_ERR_NODE_NOT_FOUND;
+  case AdtModder::Error::PropertyNotFound:
+    return ADT_MODDER_ERR_PROPERTY_NOT_FOUND;
+  case AdtModder::Error::NodeAlreadyExists:
+    return ADT_MODDER_ERR_NODE_ALREADY_EXISTS;
+  case AdtModder::Error::MalformedAdt:
+    return ADT_MODDER_ERR_MALFORMED_ADT;
+  case AdtModder::Error::MalformedPatch:
+    return ADT_MODDER_ERR_MALFORMED_PATCH;
+  case AdtModder::Error::PatchMismatch:
+    return ADT_MODDER_ERR_PATCH_MISMATCH;
+  case AdtModder::Error::OutputTooSmall:
+    return ADT_MODDER_ERR_OUTPUT_TOO_SMALL;
+  }
+  return ADT_MODDER_ERR_INVALID_OPERATION;
+}
+
+} // namespace
+
+const char *adt_modder_strerror(int error) {
+  switch (error) {
+  case ADT_MODDER_OK:
+    return "Success";
+  case ADT_MODDER_ERR_MALFORMED_JSON:
+    return "Malformed Json";
+  case ADT_MODDER_ERR_INVALID_OPERATION:
+    return "Invalid operation";
+  case ADT_MODDER_ERR_NODE_NOT_FOUND:
+    return "Node not found";
+  case ADT_MODDER_ERR_PROPERTY_NOT_FOUND:
+    return "Property not found";
+  case ADT_MODDER_ERR_NODE_ALREADY_EXISTS:
+    return "Node already exists";
+  case ADT_MODDER_ERR_MALFORMED_ADT:
+    return "Malformed ADT";
+  case ADT_MODDER_ERR_MALFORMED_PATCH:
+    return "Malformed patch";
+  case ADT_MODDER_ERR_PATCH_MISMATCH:
+    return "Patch does not apply to this ADT";
+  case ADT_MODDER_ERR_OUTPUT_TOO_SMALL:
+    return "Output buffer too small";
+  }
+  return "Unknown error";
+}
+
+size_t adt_modder_op_count(void) { return OpPlan::Names().size(); }
+
+const char *adt_modder_op_name(size_t index) {
+  const auto names = OpPlan::Names();
+  // Op names are string literals, so they are null-terminated
+  return index < names.size() ? names[index].data() : nullptr;
+}
+
+int adt_modder_plan_compile(const char *json, size_t json_size,
+                            struct adt_modder_plan **plan) {
+  auto compiled = OpPlan::Parse(
+      {reinterpret_cast<const uint8_t *>(json), json_size});
+  if (compiled.is_error()) {
+    return ToC(compiled.error_value());
+  }
+  *plan = new adt_modder_plan{std::move(compiled.ok_value())};
+  return ADT_MODDER_OK;
+}
+
+void adt_modder_plan_free(struct adt_modder_plan *plan) { delete plan; }
+
+void adt_modder_plan_set_seed(struct adt_modder_plan *plan, uint64_t seed) {
+  plan->plan.SetSeed(seed);
+}
+
+int adt_modder_plan_preserves_layout(const struct adt_modder_plan *plan) {
+  return plan->plan.PreservesLayout() ? 1 : 0;
+}
+
+int adt_modder_run(const struct adt_modder_plan *plan,
+                   enum adt_modder_mode mode, const void *adt,
+                   size_t adt_size, void *out, size_t out_capacity,
+                   size_t *out_size) {
+  AdtModder::Mode modder_mode = AdtModder::Mode::Immediate;
+  if (mode == ADT_MODDER_MODE_EDIT_LOG) {
+    modder_mode = AdtModder::Mode::EditLog;
+  } else if (mode == ADT_MODDER_MODE_TREE) {
+    modder_mode = AdtModder::Mode::Tree;
+  }
+  AdtModder modder{modder_mode};
+  modder.SetVerbose(false);
+
+  size_t size = 0;
+  auto result = modder.RunToBuffer(
+      {static_cast<const uint8_t *>(adt), adt_size}, plan->plan,
+      {static_cast<uint8_t *>(out), out_capacity}, size);
+  *out_size = size;
+  return result.is_error() ? ToC(result.error_value()) : ADT_MODDER_OK;
+}
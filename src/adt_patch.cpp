@@ -0,0 +1,295 @@
+#include "adt_patch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "utils.h"
+
+using Ditto::Result;
+using Error = AdtModder::Error;
+
+namespace {
+
+// Binary patch format: a header followed by every record, as its offset, the
+// sizes of its old and new bytes, and then the bytes themselves. Patches are
+// shipped between machines, so numbers are always little-endian.
+constexpr char kPatchMagic[8] = {'A', 'D', 'T', 'P', 'A', 'T', 'C', 'H'};
+constexpr uint32_t kPatchVersion = 1;
+
+// Bytes a record takes besides the old and new bytes. Records closer than
+// half of that are cheaper to merge.
+constexpr size_t kRecordHeaderSize = 3 * sizeof(uint32_t);
+
+template <typename T> void PutLe(std::vector<uint8_t> &out, T value) {
+  for (size_t i = 0; i < sizeof(T); i++) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+class PatchReader {
+public:
+  explicit PatchReader(Ditto::span<const uint8_t> data) : m_data(data) {}
+
+  template <typename T> bool ReadLe(T &value) {
+    if (sizeof(T) > m_data.size() - m_pos) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      value |= static_cast<T>(m_data[m_pos + i]) << (8 * i);
+    }
+    m_pos += sizeof(T);
+    return true;
+  }
+
+  bool ReadBytes(std::vector<uint8_t> &bytes, uint32_t size) {
+    if (size > m_data.size() - m_pos) {
+      return false;
+    }
+    bytes.assign(&m_data[m_pos], &m_data[m_pos] + size);
+    m_pos += size;
+    return true;
+  }
+
+  [[nodiscard]] bool AtEnd() const { return m_pos == m_data.size(); }
+
+private:
+  Ditto::span<const uint8_t> m_data;
+  size_t m_pos = 0;
+};
+
+} // namespace
+
+AdtPatch AdtPatch::Diff(Ditto::span<const uint8_t> original,
+                        Ditto::span<const uint8_t> edited,
+                        const ExtentList &extents) {
+  AdtPatch patch;
+  patch.m_original_size = original.size();
+  patch.m_original_hash = utils::hashBytes(original.data(), original.size());
+  patch.m_result_size = extents.Size();
+  patch.m_result_hash = utils::hashBytes(nullptr, 0);
+
+  // Walk the output, matching every extent that comes from the input against
+  // the original. Whatever lies in between replaces the original bytes that
+  // were skipped over.
+  const std::less_equal<const uint8_t *> before_or_at;
+  std::vector<uint8_t> replacement;
+  size_t cursor = 0;
+  for (const auto &extent : extents.Extents()) {
+    patch.m_result_hash =
+        utils::hashBytes(extent.data, extent.size, patch.m_result_hash);
+
+    // Ranges modified in memory still point into the edited input
+    size_t offset = extent.input_offset;
+    if (offset == ExtentList::kNotInInput &&
+        before_or_at(edited.data(), extent.data) &&
+        before_or_at(extent.data + extent.size,
+                     edited.data() + edited.size())) {
+      offset = extent.data - edited.data();
+    }
+
+    if (offset == ExtentList::kNotInInput || offset < cursor) {
+      replacement.insert(replacement.end(), extent.data,
+                         extent.data + extent.size);
+      continue;
+    }
+
+    patch.Push(original, cursor, offset - cursor,
+               {replacement.data(), replacement.size()});
+    replacement.clear();
+    if (extent.input_offset == ExtentList::kNotInInput) {
+      patch.PushChanges(original, offset, {extent.data, extent.size});
+    }
+    cursor = offset + extent.size;
+  }
+  patch.Push(original, cursor, original.size() - cursor,
+             {replacement.data(), replacement.size()});
+  return patch;
+}
+
+void AdtPatch::Push(Ditto::span<const uint8_t> original, uint32_t offset,
+                    size_t old_size, Ditto::span<const uint8_t> new_bytes) {
+  // Only keep the bytes that actually change
+  const uint8_t *old_data = original.data() + offset;
+  const uint8_t *new_data = new_bytes.data();
+  size_t new_size = new_bytes.size();
+  size_t prefix = 0;
+  while (prefix < old_size && prefix < new_size &&
+         old_data[prefix] == new_data[prefix]) {
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < old_size - prefix && suffix < new_size - prefix &&
+         old_data[old_size - 1 - suffix] == new_data[new_size - 1 - suffix]) {
+    suffix++;
+  }
+  offset += prefix;
+  old_data += prefix;
+  new_data += prefix;
+  old_size -= prefix + suffix;
+  new_size -= prefix + suffix;
+  if (old_size == 0 && new_size == 0) {
+    return;
+  }
+
+  if (!m_records.empty()) {
+    Record &last = m_records.back();
+    const uint32_t end = last.offset + last.old_bytes.size();
+    if (2 * (offset - end) <= kRecordHeaderSize) {
+      const uint8_t *gap = original.data() + end;
+      last.old_bytes.insert(last.old_bytes.end(), gap, old_data);
+      last.old_bytes.insert(last.old_bytes.end(), old_data,
+                            old_data + old_size);
+      last.new_bytes.insert(last.new_bytes.end(), gap,
+                            original.data() + offset);
+      last.new_bytes.insert(last.new_bytes.end(), new_data,
+                            new_data + new_size);
+      return;
+    }
+  }
+
+  m_records.push_back({offset,
+                       {old_data, old_data + old_size},
+                       {new_data, new_data + new_size}});
+}
+
+void AdtPatch::PushChanges(Ditto::span<const uint8_t> original,
+                           uint32_t offset,
+                           Ditto::span<const uint8_t> edited) {
+  const uint8_t *old_data = original.data() + offset;
+  size_t i = 0;
+  while (i < edited.size()) {
+    if (edited[i] == old_data[i]) {
+      i++;
+      continue;
+    }
+
+    const size_t begin = i;
+    while (i < edited.size() && edited[i] != old_data[i]) {
+      i++;
+    }
+    Push(original, offset + begin, i - begin, {&edited[begin], i - begin});
+  }
+}
+
+std::vector<uint8_t> AdtPatch::Serialize() const {
+  std::vector<uint8_t> out(kPatchMagic, kPatchMagic + sizeof(kPatchMagic));
+  PutLe(out, kPatchVersion);
+  PutLe(out, static_cast<uint32_t>(m_records.size()));
+  PutLe(out, m_original_size);
+  PutLe(out, m_original_hash);
+  PutLe(out, m_result_size);
+  PutLe(out, m_result_hash);
+
+  for (const auto &record : m_records) {
+    PutLe(out, record.offset);
+    PutLe(out, static_cast<uint32_t>(record.old_bytes.size()));
+    PutLe(out, static_cast<uint32_t>(record.new_bytes.size()));
+    out.insert(out.end(), record.old_bytes.begin(), record.old_bytes.end());
+    out.insert(out.end(), record.new_bytes.begin(), record.new_bytes.end());
+  }
+  return out;
+}
+
+Result<AdtPatch, Error>
+AdtPatch::Deserialize(Ditto::span<const uint8_t> data) noexcept {
+  if (data.size() < sizeof(kPatchMagic) ||
+      memcmp(data.data(), kPatchMagic, sizeof(kPatchMagic)) != 0) {
+    return Error::MalformedPatch;
+  }
+
+  PatchReader reader{{data.data() + sizeof(kPatchMagic),
+                      data.size() - sizeof(kPatchMagic)}};
+  AdtPatch patch;
+  uint32_t version;
+  uint32_t record_count;
+  if (!reader.ReadLe(version) || version != kPatchVersion ||
+      !reader.ReadLe(record_count) || !reader.ReadLe(patch.m_original_size) ||
+      !reader.ReadLe(patch.m_original_hash) ||
+      !reader.ReadLe(patch.m_result_size) ||
+      !reader.ReadLe(patch.m_result_hash)) {
+    return Error::MalformedPatch;
+  }
+
+  // Records must be sorted, disjoint and add up to the result size
+  uint64_t end = 0;
+  uint64_t result_size = patch.m_original_size;
+  for (uint32_t i = 0; i < record_count; i++) {
+    Record record;
+    uint32_t old_size;
+    uint32_t new_size;
+    if (!reader.ReadLe(record.offset) || !reader.ReadLe(old_size) ||
+        !reader.ReadLe(new_size) || record.offset < end ||
+        uint64_t{record.offset} + old_size > patch.m_original_size ||
+        !reader.ReadBytes(record.old_bytes, old_size) ||
+        !reader.ReadBytes(record.new_bytes, new_size)) {
+      return Error::MalformedPatch;
+    }
+    end = uint64_t{record.offset} + old_size;
+    result_size = result_size - old_size + new_size;
+    patch.m_records.push_back(std::move(record));
+  }
+
+  if (!reader.AtEnd() || result_size != patch.m_result_size) {
+    return Error::MalformedPatch;
+  }
+  return patch;
+}
+
+AdtPatch AdtPatch::Inverse() const {
+  AdtPatch inverse;
+  inverse.m_original_size = m_result_size;
+  inverse.m_original_hash = m_result_hash;
+  inverse.m_result_size = m_original_size;
+  inverse.m_result_hash = m_original_hash;
+
+  // Records land in the output shifted by the size change of the ones before
+  int64_t shift = 0;
+  for (const auto &record : m_records) {
+    inverse.m_records.push_back({static_cast<uint32_t>(record.offset + shift),
+                                 record.new_bytes, record.old_bytes});
+    shift += static_cast<int64_t>(record.new_bytes.size()) -
+             static_cast<int64_t>(record.old_bytes.size());
+  }
+  return inverse;
+}
+
+bool AdtPatch::AppliesTo(Ditto::span<const uint8_t> adt) const {
+  if (adt.size() != m_original_size) {
+    return false;
+  }
+  for (const auto &record : m_records) {
+    if (memcmp(&adt[record.offset], record.old_bytes.data(),
+               record.old_bytes.size()) != 0) {
+      return false;
+    }
+  }
+  return utils::hashBytes(adt.data(), adt.size()) == m_original_hash;
+}
+
+Result<ExtentList, Error>
+AdtPatch::Apply(Ditto::span<const uint8_t> adt) const noexcept {
+  if (!AppliesTo(adt)) {
+    return Error::PatchMismatch;
+  }
+
+  ExtentList extents{adt, {}};
+  size_t cursor = 0;
+  for (const auto &record : m_records) {
+    extents.AddInput(cursor, record.offset - cursor);
+    extents.AddBuffer(Ditto::span<const uint8_t>{record.new_bytes.data(),
+                                                 record.new_bytes.size()});
+    cursor = record.offset + record.old_bytes.size();
+  }
+  extents.AddInput(cursor, adt.size() - cursor);
+  return extents;
+}
+
+bool AdtPatch::PreservesLayout() const {
+  return std::all_of(m_records.begin(), m_records.end(),
+                     [](const Record &record) {
+                       return record.old_bytes.size() ==
+                              record.new_bytes.size();
+                     });
+}
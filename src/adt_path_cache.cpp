@@ -0,0 +1,202 @@
+#include "adt_path_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "adt.h"
+
+template <typename Key>
+uint32_t AdtPathCache::OffsetTable<Key>::Find(const Key &key) const {
+  const auto it = m_slots.find(key);
+  return it != m_slots.cend() ? m_offsets[it->second] : AdtIndex::kNone;
+}
+
+template <typename Key>
+void AdtPathCache::OffsetTable<Key>::Set(const Key &key, uint32_t offset) {
+  auto [it, inserted] = m_slots.try_emplace(key, 0);
+  if (inserted) {
+    if (m_free.empty()) {
+      it->second = static_cast<uint32_t>(m_offsets.size());
+      m_keys.push_back(key);
+      m_offsets.push_back(offset);
+    } else {
+      it->second = m_free.back();
+      m_free.pop_back();
+      m_keys[it->second] = key;
+    }
+  } else {
+    size_t position = LowerBound(m_offsets[it->second]);
+    while (m_order[position] != it->second) {
+      position++;
+    }
+    m_order.erase(m_order.begin() + position);
+  }
+
+  const uint32_t slot = it->second;
+  m_offsets[slot] = offset;
+  m_order.insert(m_order.begin() + LowerBound(offset), slot);
+}
+
+template <typename Key>
+void AdtPathCache::OffsetTable<Key>::OnInsert(uint32_t offset, uint32_t size) {
+  for (size_t i = LowerBound(offset); i < m_order.size(); i++) {
+    m_offsets[m_order[i]] += size;
+  }
+}
+
+template <typename Key>
+void AdtPathCache::OffsetTable<Key>::OnRemove(uint32_t offset, uint32_t size) {
+  const size_t begin = LowerBound(offset);
+  const size_t end = LowerBound(offset + size);
+  for (size_t i = end; i < m_order.size(); i++) {
+    m_offsets[m_order[i]] -= size;
+  }
+  Free(begin, end);
+}
+
+template <typename Key>
+void AdtPathCache::OffsetTable<Key>::Drop(uint32_t begin, uint32_t end) {
+  Free(LowerBound(begin + 1), LowerBound(end));
+}
+
+template <typename Key> void AdtPathCache::OffsetTable<Key>::Clear() {
+  m_slots.clear();
+  m_keys.clear();
+  m_offsets.clear();
+  m_free.clear();
+  m_order.clear();
+}
+
+template <typename Key>
+size_t AdtPathCache::OffsetTable<Key>::LowerBound(uint32_t offset) const {
+  return std::partition_point(m_order.begin(), m_order.end(),
+                              [this, offset](uint32_t slot) {
+                                return m_offsets[slot] < offset;
+                              }) -
+         m_order.begin();
+}
+
+template <typename Key>
+void AdtPathCache::OffsetTable<Key>::Free(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    m_slots.erase(m_keys[m_order[i]]);
+    m_keys[m_order[i]] = Key{};
+    m_free.push_back(m_order[i]);
+  }
+  m_order.erase(m_order.begin() + begin, m_order.begin() + end);
+}
+
+std::string AdtPathCache::Normalize(std::string_view path) {
+  std::string normalized;
+  normalized.reserve(path.size() + 1);
+
+  size_t pos = 0;
+  while (pos < path.size()) {
+    while (pos < path.size() && path[pos] == '/') {
+      pos++;
+    }
+    if (pos == path.size()) {
+      break;
+    }
+
+    size_t end = path.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+
+    normalized.push_back('/');
+    normalized.append(path.substr(pos, end - pos));
+    pos = end;
+  }
+
+  if (normalized.empty()) {
+    normalized.push_back('/');
+  }
+  return normalized;
+}
+
+int AdtPathCache::Resolve(const AdtIndex &index, const uint8_t *adt,
+                          std::string_view path) {
+  if (index.size() == 0) {
+    return -ADT_ERR_BADOFFSET;
+  }
+
+  std::string key = Normalize(path);
+  if (key.size() == 1) {
+    return 0;
+  }
+
+  if (const uint32_t offset = m_offsets.Find(key); offset != AdtIndex::kNone) {
+    return static_cast<int>(offset);
+  }
+
+  // Component boundaries: key[0, ends[i]) is the path of the i-th component
+  std::vector<size_t> ends;
+  for (size_t pos = 1; pos <= key.size(); pos++) {
+    if (pos == key.size() || key[pos] == '/') {
+      ends.push_back(pos);
+    }
+  }
+
+  // Find the longest cached prefix, starting from the root
+  size_t resolved = ends.size() - 1;
+  uint32_t node = 0;
+  while (resolved > 0) {
+    const uint32_t offset = m_offsets.Find(key.substr(0, ends[resolved - 1]));
+    if (offset != AdtIndex::kNone) {
+      node = index.Find(offset);
+      break;
+    }
+    resolved--;
+  }
+
+  for (; resolved < ends.size(); resolved++) {
+    const size_t begin = resolved == 0 ? 1 : ends[resolved - 1] + 1;
+    const std::string_view name{&key[begin], ends[resolved] - begin};
+
+    node = index.ChildIndex(adt, node, name);
+    if (node == AdtIndex::kNone) {
+      return -ADT_ERR_NOTFOUND;
+    }
+    m_offsets.Set(key.substr(0, ends[resolved]), index[node].offset);
+  }
+
+  return index[node].offset;
+}
+
+void AdtPathCache::Insert(std::string_view path, uint32_t offset) {
+  m_offsets.Set(Normalize(path), offset);
+}
+
+void AdtPathCache::OnInsert(uint32_t offset, uint32_t size) {
+  m_offsets.OnInsert(offset, size);
+  m_pinned.OnInsert(offset, size);
+}
+
+void AdtPathCache::OnRemove(uint32_t offset, uint32_t size) {
+  m_offsets.OnRemove(offset, size);
+  m_pinned.OnRemove(offset, size);
+}
+
+void AdtPathCache::OnRename(const AdtIndex &index, uint32_t offset) {
+  // The root is never looked up by name
+  const uint32_t node = index.Find(offset);
+  if (node == AdtIndex::kNone || index[node].parent == AdtIndex::kNone) {
+    return;
+  }
+  const AdtIndex::Node &parent = index[index[node].parent];
+  m_offsets.Drop(parent.offset, parent.end);
+}
+
+void AdtPathCache::Pin(uint32_t node, uint32_t offset) {
+  m_pinned.Set(node, offset);
+}
+
+uint32_t AdtPathCache::Pinned(uint32_t node) const {
+  return m_pinned.Find(node);
+}
+
+void AdtPathCache::Clear() {
+  m_offsets.Clear();
+  m_pinned.Clear();
+}
@@ -0,0 +1,214 @@
+#include "adt_property_index.h"
+
+#include <cstring>
+
+#include "adt.h"
+#include "utils.h"
+
+namespace {
+
+// Scans the property list, as the unindexed lookups do
+int ScanProperties(const uint8_t *adt, uint32_t node_offset,
+                   std::string_view name) {
+  auto *data = const_cast<uint8_t *>(adt);
+  const auto *prop =
+      adt_get_property_namelen(data, node_offset, name.data(), name.size());
+  if (prop == nullptr) {
+    return -ADT_ERR_NOTFOUND;
+  }
+  return reinterpret_cast<const uint8_t *>(prop) - adt;
+}
+
+} // namespace
+
+uint32_t AdtPropertyIndex::Hash(std::string_view name) {
+  const uint64_t hash = utils::hashBytes(
+      reinterpret_cast<const uint8_t *>(name.data()), name.size());
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+std::string_view AdtPropertyIndex::PropertyName(const uint8_t *adt,
+                                                uint32_t offset) {
+  const auto *prop = reinterpret_cast<const adt_property *>(adt + offset);
+  return {prop->name, strnlen(prop->name, sizeof(prop->name))};
+}
+
+int AdtPropertyIndex::Find(const AdtIndex &index, const uint8_t *adt,
+                           uint32_t node_offset, std::string_view name) {
+  // Names that do not fit in the name field keep the scan semantics
+  if (name.size() >= sizeof(adt_property::name)) {
+    return ScanProperties(adt, node_offset, name);
+  }
+
+  Table *table = TableFor(index, node_offset);
+  if (table == nullptr) {
+    return ScanProperties(adt, node_offset, name);
+  }
+
+  if (!table->IsBuilt()) {
+    auto *data = const_cast<uint8_t *>(adt);
+    if (static_cast<uint32_t>(adt_get_property_count(data, node_offset)) <
+        kMinProperties) {
+      return ScanProperties(adt, node_offset, name);
+    }
+    Build(adt, node_offset, *table);
+  }
+
+  const Slot &slot = Probe(adt, node_offset, *table, name, Hash(name));
+  if (slot.offset == 0) {
+    return -ADT_ERR_NOTFOUND;
+  }
+  return node_offset + slot.offset;
+}
+
+void AdtPropertyIndex::OnPropertyAdded(const AdtIndex &index,
+                                       const uint8_t *adt,
+                                       uint32_t node_offset, uint32_t offset,
+                                       uint32_t size) {
+  Table *table = TableFor(index, node_offset);
+  if (table == nullptr || !table->IsBuilt()) {
+    return;
+  }
+
+  const uint32_t relative = offset - node_offset;
+  for (auto &slot : table->slots) {
+    if (slot.offset >= relative) {
+      slot.offset += size;
+    }
+  }
+
+  // Grow by rebuilding on the next lookup
+  if ((table->count + 1) * 2 > table->slots.size()) {
+    *table = Table{};
+    return;
+  }
+
+  const auto name = PropertyName(adt, offset);
+  const uint32_t hash = Hash(name);
+  Slot &slot = Probe(adt, node_offset, *table, name, hash);
+  if (slot.offset != 0) {
+    table->has_duplicates = true;
+    return;
+  }
+  slot = {hash, relative};
+  table->count++;
+}
+
+void AdtPropertyIndex::OnPropertyRemoved(const AdtIndex &index,
+                                         uint32_t node_offset,
+                                         std::string_view name,
+                                         uint32_t offset, uint32_t size) {
+  Table *table = TableFor(index, node_offset);
+  if (table == nullptr || !table->IsBuilt()) {
+    return;
+  }
+
+  // A later property with the same name would take its place
+  if (table->has_duplicates) {
+    *table = Table{};
+    return;
+  }
+
+  // The property is gone from the ADT, so look its slot up by offset
+  const uint32_t relative = offset - node_offset;
+  const size_t mask = table->slots.size() - 1;
+  for (size_t i = Hash(name) & mask; table->slots[i].offset != 0;
+       i = (i + 1) & mask) {
+    if (table->slots[i].offset == relative) {
+      Erase(*table, table->slots[i]);
+      break;
+    }
+  }
+
+  for (auto &slot : table->slots) {
+    if (slot.offset > relative) {
+      slot.offset -= size;
+    }
+  }
+}
+
+void AdtPropertyIndex::OnNodeAdded(const AdtIndex &index, uint32_t offset) {
+  if (m_tables.empty()) {
+    return;
+  }
+
+  const uint32_t node = index.Find(offset);
+  if (node != AdtIndex::kNone) {
+    m_tables.insert(m_tables.begin() + node, Table{});
+  }
+}
+
+AdtPropertyIndex::Table *AdtPropertyIndex::TableFor(const AdtIndex &index,
+                                                    uint32_t node_offset) {
+  if (m_tables.empty()) {
+    m_tables.resize(index.size());
+  }
+
+  const uint32_t node = index.Find(node_offset);
+  if (node == AdtIndex::kNone || node >= m_tables.size()) {
+    return nullptr;
+  }
+  return &m_tables[node];
+}
+
+void AdtPropertyIndex::Build(const uint8_t *adt, uint32_t node_offset,
+                             Table &table) {
+  auto *data = const_cast<uint8_t *>(adt);
+  const uint32_t count = adt_get_property_count(data, node_offset);
+
+  size_t capacity = 16;
+  while (capacity < count * 2) {
+    capacity *= 2;
+  }
+  table = Table{};
+  table.slots.assign(capacity, Slot{0, 0});
+
+  int offset = adt_first_property_offset(data, node_offset);
+  for (uint32_t i = 0; i < count; i++) {
+    const auto name = PropertyName(adt, offset);
+    const uint32_t hash = Hash(name);
+    Slot &slot = Probe(adt, node_offset, table, name, hash);
+    if (slot.offset != 0) {
+      table.has_duplicates = true;
+    } else {
+      slot = {hash, offset - node_offset};
+      table.count++;
+    }
+    offset = adt_next_property_offset(data, offset);
+  }
+}
+
+AdtPropertyIndex::Slot &AdtPropertyIndex::Probe(const uint8_t *adt,
+                                                uint32_t node_offset,
+                                                Table &table,
+                                                std::string_view name,
+                                                uint32_t hash) {
+  const size_t mask = table.slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Slot &slot = table.slots[i];
+    if (slot.offset == 0 ||
+        (slot.hash == hash &&
+         PropertyName(adt, node_offset + slot.offset) == name)) {
+      return slot;
+    }
+  }
+}
+
+void AdtPropertyIndex::Erase(Table &table, Slot &erased) {
+  // Backward-shift deletion: move later entries of the probe sequence into the
+  // hole, unless that would move them before their home slot
+  const size_t mask = table.slots.size() - 1;
+  size_t hole = &erased - table.slots.data();
+  for (size_t i = (hole + 1) & mask; table.slots[i].offset != 0;
+       i = (i + 1) & mask) {
+    const size_t home = table.slots[i].hash & mask;
+    const bool movable = hole <= i ? (home <= hole || home > i)
+                                   : (home <= hole && home > i);
+    if (movable) {
+      table.slots[hole] = table.slots[i];
+      hole = i;
+    }
+  }
+  table.slots[hole] = Slot{0, 0};
+  table.count--;
+}
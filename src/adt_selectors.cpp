@@ -0,0 +1,146 @@
+#include "adt_selectors.h"
+
+#include <algorithm>
+
+namespace {
+
+// Matches a whole node name against a component with `*` wildcards,
+// backtracking to the last `*` on a mismatch
+bool WildcardMatches(std::string_view pattern, std::string_view name) {
+  size_t p = 0;
+  size_t n = 0;
+  size_t star = std::string_view::npos;
+  size_t resume = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = n;
+    } else if (p < pattern.size() && pattern[p] == name[n]) {
+      p++;
+      n++;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      n = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+} // namespace
+
+size_t AdtSelectors::Add(std::string_view selector) {
+  // Split like adt_path_offset() does, ignoring repeated separators
+  std::vector<std::string> components;
+  size_t pos = 0;
+  while (pos < selector.size()) {
+    size_t end = selector.find('/', pos);
+    if (end == std::string_view::npos) {
+      end = selector.size();
+    }
+    if (end > pos) {
+      components.emplace_back(selector.substr(pos, end - pos));
+    }
+    pos = end + 1;
+  }
+
+  m_selectors.push_back(std::move(components));
+  return m_selectors.size() - 1;
+}
+
+std::vector<std::vector<AdtSelectors::Hit>>
+AdtSelectors::Match(const uint8_t *adt, const AdtIndex &index) const {
+  std::vector<std::vector<Hit>> hits(m_selectors.size());
+  if (index.size() == 0) {
+    return hits;
+  }
+
+  // Selectors still matching along the path to the node being visited. Every
+  // level holds the states of a node, the end of its subtree in the index and
+  // the size of its path.
+  struct Level {
+    std::vector<State> states;
+    uint32_t end;
+    size_t path_size;
+  };
+  std::vector<Level> levels;
+  std::string path;
+
+  std::vector<State> states;
+  for (uint32_t i = 0; i < m_selectors.size(); i++) {
+    AddState(states, {i, 0});
+  }
+  for (const State &state : states) {
+    if (state.component == m_selectors[state.selector].size()) {
+      hits[state.selector].push_back({"/", index[0].offset});
+    }
+  }
+  levels.push_back({std::move(states), static_cast<uint32_t>(index.size()),
+                    0});
+
+  uint32_t i = 1;
+  while (i < index.size()) {
+    while (i >= levels.back().end) {
+      levels.pop_back();
+    }
+    const Level &parent = levels.back();
+    const AdtIndex::Node &node = index[i];
+
+    const std::string_view name = index.Name(adt, i);
+
+    states.clear();
+    for (const State &state : parent.states) {
+      const auto &components = m_selectors[state.selector];
+      if (state.component == components.size()) {
+        continue;
+      }
+      const std::string &component = components[state.component];
+      if (component == "**") {
+        AddState(states, state);
+      } else if (ComponentMatches(component, name, node.name_size)) {
+        AddState(states, {state.selector, state.component + 1});
+      }
+    }
+    if (states.empty()) {
+      i += node.subtree_size;
+      continue;
+    }
+
+    path.resize(parent.path_size);
+    path.push_back('/');
+    path.append(name);
+    for (const State &state : states) {
+      if (state.component == m_selectors[state.selector].size()) {
+        hits[state.selector].push_back({path, node.offset});
+      }
+    }
+    levels.push_back({std::move(states), i + node.subtree_size, path.size()});
+    i++;
+  }
+
+  return hits;
+}
+
+void AdtSelectors::AddState(std::vector<State> &states, State state) const {
+  const auto &components = m_selectors[state.selector];
+  while (std::find(states.begin(), states.end(), state) == states.end()) {
+    states.push_back(state);
+    if (state.component == components.size() ||
+        components[state.component] != "**") {
+      return;
+    }
+    state.component++;
+  }
+}
+
+bool AdtSelectors::ComponentMatches(std::string_view pattern,
+                                    std::string_view name, size_t name_size) {
+  if (IsPattern(pattern)) {
+    return WildcardMatches(pattern, name);
+  }
+  return AdtIndex::NodeNameEquals(name.data(), name_size, pattern);
+}
@@ -0,0 +1,383 @@
+#include "adt_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <random>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "adt.h"
+#include "adt_patch.h"
+#include "fmt/core.h"
+#include "thread_pool.h"
+
+using Ditto::Result;
+
+namespace {
+
+// Requests are short, anything longer is not a client of ours
+constexpr size_t kMaxRequestSize = 64 * 1024;
+// Base ADTs and plans kept loaded, each
+constexpr size_t kMaxLoaded = 32;
+
+// Returns what `loaded` holds for `path`, loading it with `load` if it is
+// missing or the file changed since it was loaded. `uses` counts the uses of
+// every entry, so the least recently used one can be dropped once there are
+// too many.
+template <typename Map, typename Load>
+auto GetLoaded(std::mutex &mutex, Map &loaded, uint64_t &uses,
+               const std::string &path, Load load)
+    -> decltype(load(path)) {
+  std::error_code error;
+  const auto modified = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return fmt::format("Unable to open {}: {}", path, error.message());
+  }
+
+  {
+    std::lock_guard lock{mutex};
+    if (auto it = loaded.find(path);
+        it != loaded.end() && it->second.modified == modified) {
+      it->second.last_used = ++uses;
+      return it->second.value;
+    }
+  }
+
+  // Loaded without holding the lock. Clients racing to load the same file
+  // load it twice, which is harmless.
+  auto value = load(path);
+  if (value.is_ok()) {
+    std::lock_guard lock{mutex};
+    loaded[path] = {modified, value.ok_value(), ++uses};
+    if (loaded.size() > kMaxLoaded) {
+      loaded.erase(std::min_element(
+          loaded.begin(), loaded.end(), [](const auto &a, const auto &b) {
+            return a.second.last_used < b.second.last_used;
+          }));
+    }
+  }
+  return value;
+}
+
+Result<std::vector<uint8_t>, std::string> ReadFile(const std::string &path) {
+  auto file = File::Open(path.c_str());
+  if (file.is_error()) {
+    return fmt::format("Unable to open {}: {}", path,
+                       File::error_to_string(file.error_value()));
+  }
+  auto data = file.ok_value().ReadAll();
+  if (data.is_error()) {
+    return fmt::format("Unable to read {}: {}", path,
+                       File::error_to_string(data.error_value()));
+  }
+  return std::move(data.ok_value());
+}
+
+Result<void, std::string> WriteResponse(File &client,
+                                        const nlohmann::json &response) {
+  std::string line = response.dump() + "\n";
+  auto result = client.Write(
+      {reinterpret_cast<uint8_t *>(line.data()), line.size()});
+  if (result.is_error()) {
+    return std::string{"Client went away"};
+  }
+  return Result<void, std::string>::ok();
+}
+
+// Writes the output next to `path` and renames it over it
+Result<void, std::string> WriteOutput(const std::string &path,
+                                      const ExtentList &extents) {
+  std::string temp_name;
+  auto temp = File::CreateTemporary(path, temp_name);
+  auto result = temp.is_ok() ? temp.ok_value().WriteExtents(extents, nullptr)
+                             : Result<void, File::Error>{temp.error_value()};
+  if (result.is_ok()) {
+    result = File::Rename(temp_name, path);
+  }
+  if (result.is_error()) {
+    File::Remove(temp_name);
+    return fmt::format("Unable to write {}: {}", path,
+                       File::error_to_string(result.error_value()));
+  }
+  return Result<void, std::string>::ok();
+}
+
+} // namespace
+
+Result<void, std::string> AdtServer::Serve(const std::string &socket_path,
+                                           size_t workers) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return fmt::format("Socket path {} is too long", socket_path);
+  }
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return fmt::format("Unable to create a socket: {}", strerror(errno));
+  }
+  File listener = File::FromDescriptor(fd);
+
+  // Sockets left behind by a previous server are replaced, anything else at
+  // the path is left alone
+  struct stat existing;
+  if (lstat(socket_path.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      return fmt::format("{} exists and is not a socket", socket_path);
+    }
+    unlink(socket_path.c_str());
+  }
+  if (bind(fd, reinterpret_cast<const sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    return fmt::format("Unable to listen on {}: {}", socket_path,
+                       strerror(errno));
+  }
+
+  // Clients hanging up in the middle of a response are reported as write
+  // errors instead
+  signal(SIGPIPE, SIG_IGN);
+
+  // Workers hand clients back once their requests ran, and wake the loop
+  // below through the pipe
+  int wake[2];
+  if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) < 0) {
+    return fmt::format("Unable to create a pipe: {}", strerror(errno));
+  }
+  File wake_read = File::FromDescriptor(wake[0]);
+  File wake_write = File::FromDescriptor(wake[1]);
+  std::mutex returned_mutex;
+  std::vector<std::shared_ptr<Client>> returned;
+  const auto hand_back = [&](std::shared_ptr<Client> client) {
+    {
+      std::lock_guard lock{returned_mutex};
+      returned.push_back(std::move(client));
+    }
+    // A full pipe already wakes the loop
+    uint8_t byte = 0;
+    (void)wake_write.Write({&byte, 1});
+  };
+
+  // Clients waiting for their next request
+  std::vector<std::shared_ptr<Client>> idle;
+  std::vector<pollfd> fds;
+  std::vector<uint8_t> chunk(kMaxRequestSize);
+  ThreadPool pool{workers};
+  fmt::print("Serving on {} with {} workers\n", socket_path, pool.Workers());
+  while (true) {
+    fds.assign({{fd, POLLIN, 0}, {wake[0], POLLIN, 0}});
+    for (const auto &client : idle) {
+      fds.push_back({client->fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return fmt::format("Unable to wait for clients: {}", strerror(errno));
+    }
+
+    // Clients that sent a complete request leave for a worker, the ones that
+    // went away or sent too much are dropped, closing their connection
+    std::vector<std::shared_ptr<Client>> still_idle;
+    for (size_t i = 0; i < idle.size(); i++) {
+      auto &client = idle[i];
+      if (fds[i + 2].revents == 0) {
+        still_idle.push_back(std::move(client));
+        continue;
+      }
+      auto read = client->file.ReadSome({chunk.data(), chunk.size()});
+      if (read.is_error() || read.ok_value() == 0) {
+        continue;
+      }
+      client->pending.append(reinterpret_cast<const char *>(chunk.data()),
+                             read.ok_value());
+      if (client->pending.find('\n') != std::string::npos) {
+        pool.Submit([this, client, &hand_back](size_t) {
+          if (ServeRequests(*client)) {
+            hand_back(client);
+          }
+        });
+      } else if (client->pending.size() <= kMaxRequestSize) {
+        still_idle.push_back(std::move(client));
+      }
+    }
+    idle = std::move(still_idle);
+
+    if (fds[1].revents != 0) {
+      while (wake_read.ReadSome({chunk.data(), chunk.size()}).is_ok()) {
+      }
+      std::lock_guard lock{returned_mutex};
+      for (auto &client : returned) {
+        idle.push_back(std::move(client));
+      }
+      returned.clear();
+    }
+
+    if (fds[0].revents != 0) {
+      const int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client >= 0) {
+        idle.push_back(std::make_shared<Client>(
+            Client{client, File::FromDescriptor(client), {}}));
+      } else if (errno != EINTR && errno != ECONNABORTED) {
+        return fmt::format("Unable to accept clients: {}", strerror(errno));
+      }
+    }
+  }
+}
+
+bool AdtServer::ServeRequests(Client &client) {
+  size_t newline;
+  while ((newline = client.pending.find('\n')) != std::string::npos) {
+    if (!HandleRequest(client.file, {client.pending.data(), newline})) {
+      return false;
+    }
+    client.pending.erase(0, newline + 1);
+  }
+  return client.pending.size() <= kMaxRequestSize;
+}
+
+bool AdtServer::HandleRequest(File &client, std::string_view line) {
+  const auto request = nlohmann::json::parse(line, nullptr, false);
+  std::string error = "Malformed request";
+  if (request.is_object()) {
+    nlohmann::json response;
+    try {
+      auto result = RunRequest(client, request, response);
+      if (result.is_ok()) {
+        return true;
+      }
+      error = std::move(result.error_value());
+    } catch (const nlohmann::json::exception &exc) {
+      // Fields of the wrong type
+      error = fmt::format("Malformed request: {}", exc.what());
+    }
+  }
+  return WriteResponse(client, {{"ok", false}, {"error", error}}).is_ok();
+}
+
+Result<void, std::string>
+AdtServer::RunRequest(File &client, const nlohmann::json &request,
+                      nlohmann::json &response) {
+  const auto adt_path = request.value("adt", std::string{});
+  const auto ops_path = request.value("ops", std::string{});
+  if (adt_path.empty() || ops_path.empty()) {
+    return std::string{"Requests need an \"adt\" and an \"ops\" path"};
+  }
+  const auto adt = DITTO_PROPAGATE(GetAdt(adt_path));
+  const auto plan = DITTO_PROPAGATE(GetPlan(ops_path));
+
+  // Seeding writes to the plan, so seeded runs get their own copy
+  const OpPlan *run_plan = plan.get();
+  std::optional<OpPlan> seeded;
+  if (plan->IsRandomized()) {
+    uint64_t seed;
+    if (request.contains("seed") && request["seed"].is_number_unsigned()) {
+      seed = request["seed"].get<uint64_t>();
+    } else {
+      std::random_device device;
+      seed = (uint64_t{device()} << 32) | device();
+      response["seed"] = seed;
+    }
+    seeded = *plan;
+    seeded->SetSeed(seed);
+    run_plan = &*seeded;
+  }
+
+  // Patches can only be diffed from the extents of the edit log
+  const bool patch = request.value("patch", false);
+  AdtModder modder{patch ? AdtModder::Mode::EditLog : m_mode};
+  modder.SetVerbose(false);
+
+  std::vector<uint8_t> work = *adt;
+  const Ditto::span<uint8_t> data{work.data(), work.size()};
+  const Ditto::span<const uint8_t> input{work.data(), work.size()};
+  std::optional<ExtentList> extents;
+  if (run_plan->PreservesLayout()) {
+    auto touched = modder.RunInPlace(data, *run_plan);
+    if (touched.is_error()) {
+      return fmt::format("Error running commands: {}",
+                         AdtModder::error_to_string(touched.error_value()));
+    }
+    std::vector<ExtentList::Range> modified;
+    for (const auto &range : touched.ok_value()) {
+      modified.push_back({range.offset, range.size});
+    }
+    extents.emplace(input, std::move(modified));
+    extents->AddInput(0, data.size());
+  } else {
+    auto result = modder.RunToExtents(data, *run_plan);
+    if (result.is_error()) {
+      return fmt::format("Error running commands: {}",
+                         AdtModder::error_to_string(result.error_value()));
+    }
+    extents.emplace(std::move(result.ok_value()));
+  }
+
+  if (patch) {
+    const auto diff =
+        AdtPatch::Diff({adt->data(), adt->size()}, input, *extents);
+    ExtentList patch_extents{{}, {}};
+    patch_extents.AddBuffer(diff.Serialize());
+    extents.emplace(std::move(patch_extents));
+  }
+
+  response["ok"] = true;
+  if (const auto output = request.value("output", std::string{});
+      !output.empty()) {
+    auto result = WriteOutput(output, *extents);
+    if (result.is_error()) {
+      return result;
+    }
+    return WriteResponse(client, response);
+  }
+
+  response["size"] = extents->Size();
+  auto result = WriteResponse(client, response);
+  if (result.is_error()) {
+    return result;
+  }
+  if (client.WriteExtents(*extents, nullptr).is_error()) {
+    return std::string{"Client went away"};
+  }
+  return Result<void, std::string>::ok();
+}
+
+Result<std::shared_ptr<const std::vector<uint8_t>>, std::string>
+AdtServer::GetAdt(const std::string &path) {
+  return GetLoaded(
+      m_mutex, m_adts, m_uses, path,
+      [](const std::string &path)
+          -> Result<std::shared_ptr<const std::vector<uint8_t>>,
+                    std::string> {
+        auto data = DITTO_PROPAGATE(ReadFile(path));
+        if (adt_validate(data.data(), data.size()) != 0) {
+          return fmt::format("{} is not a valid ADT", path);
+        }
+        return std::make_shared<const std::vector<uint8_t>>(std::move(data));
+      });
+}
+
+Result<std::shared_ptr<const OpPlan>, std::string>
+AdtServer::GetPlan(const std::string &path) {
+  return GetLoaded(
+      m_mutex, m_plans, m_uses, path,
+      [](const std::string &path)
+          -> Result<std::shared_ptr<const OpPlan>, std::string> {
+        const auto json_text = DITTO_PROPAGATE(ReadFile(path));
+        auto plan = OpPlan::Parse({json_text.data(), json_text.size()});
+        if (plan.is_error()) {
+          return fmt::format("Invalid operations in {}: {}", path,
+                             AdtModder::error_to_string(plan.error_value()));
+        }
+        return std::make_shared<const OpPlan>(std::move(plan.ok_value()));
+      });
+}
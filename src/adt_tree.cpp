@@ -0,0 +1,208 @@
+#include "adt_tree.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "adt.h"
+#include "utils.h"
+
+using Ditto::Result;
+
+std::string_view AdtTree::Property::Name() const {
+  return {name, strnlen(name, sizeof(adt_property::name))};
+}
+
+size_t AdtTree::Property::Size() const {
+  return sizeof(adt_property) +
+         utils::roundUpToAlignment(value.size(), ADT_ALIGN);
+}
+
+AdtTree::AdtTree() : AdtTree(Arena{}) { m_root = NewNode(nullptr); }
+
+AdtTree::AdtTree(Arena arena)
+    : m_arena(std::move(arena)), m_root(nullptr), m_size(0) {}
+
+Result<AdtTree, AdtIndex::Error> AdtTree::Parse(Ditto::span<uint8_t> adt) {
+  auto index_result = AdtIndex::Build(adt);
+  if (index_result.is_error()) {
+    return index_result.error_value();
+  }
+  const AdtIndex &index = index_result.ok_value();
+  uint8_t *data = adt.data();
+
+  // Size the arena so the whole tree fits in a single chunk
+  size_t property_count = 0;
+  for (size_t i = 0; i < index.size(); i++) {
+    property_count += adt_get_property_count(data, index[i].offset);
+  }
+  AdtTree tree{Arena{index.size() * sizeof(Node) +
+                     property_count * sizeof(Property) + alignof(Node)}};
+
+  // The index is in pre-order, so parents are created before their children
+  // and children are appended in their original order.
+  std::vector<Node *> nodes(index.size());
+  for (size_t i = 0; i < index.size(); i++) {
+    const AdtIndex::Node &entry = index[i];
+    Node *node = tree.NewNode(
+        entry.parent == AdtIndex::kNone ? nullptr : nodes[entry.parent]);
+    nodes[i] = node;
+
+    int offset = entry.first_property;
+    for (int j = adt_get_property_count(data, entry.offset); j > 0; j--) {
+      auto *prop = ADT_PROP(data, offset);
+      tree.LinkProperty(node, tree.m_arena.New<Property>(Property{
+                                  nullptr, prop->name,
+                                  Ditto::span<uint8_t>{&prop->value[0],
+                                                       ADT_SIZE(prop)},
+                                  prop->size & ~ADT_SIZE(prop)}));
+      offset = adt_next_property_offset(data, offset);
+    }
+  }
+  tree.m_root = nodes[0];
+
+  return tree;
+}
+
+AdtTree::Node *AdtTree::NewNode(Node *parent) {
+  Node *node = m_arena.New<Node>();
+  node->parent = parent;
+  if (parent != nullptr) {
+    if (parent->last_child == nullptr) {
+      parent->first_child = node;
+    } else {
+      parent->last_child->next_sibling = node;
+    }
+    parent->last_child = node;
+    parent->child_count++;
+  }
+  m_size += sizeof(adt_node_hdr);
+  return node;
+}
+
+void AdtTree::LinkProperty(Node *node, Property *property) {
+  if (node->last_property == nullptr) {
+    node->first_property = property;
+  } else {
+    node->last_property->next = property;
+  }
+  node->last_property = property;
+  node->property_count++;
+
+  if (node->name == nullptr && property->Name() == "name") {
+    node->name = property;
+  }
+  m_size += property->Size();
+}
+
+AdtTree::Node *AdtTree::FindChild(const Node *parent, std::string_view name) {
+  for (Node *child = parent->first_child; child != nullptr;
+       child = child->next_sibling) {
+    if (child->name != nullptr &&
+        AdtIndex::NodeNameEquals(
+            reinterpret_cast<const char *>(child->name->value.data()),
+            child->name->value.size(), name)) {
+      return child;
+    }
+  }
+  return nullptr;
+}
+
+AdtTree::Property *AdtTree::FindProperty(const Node *node,
+                                         std::string_view name) {
+  for (Property *prop = node->first_property; prop != nullptr;
+       prop = prop->next) {
+    if (prop->Name() == name) {
+      return prop;
+    }
+  }
+  return nullptr;
+}
+
+AdtTree::Node *AdtTree::AddChild(Node *parent, std::string_view name) {
+  Node *child = NewNode(parent);
+
+  // The name property holds a NUL-terminated copy of the name
+  std::vector<uint8_t> value(name.cbegin(), name.cend());
+  value.push_back('\0');
+  AddProperty(child, "name",
+              Ditto::span<const uint8_t>{value.data(), value.size()});
+  return child;
+}
+
+AdtTree::Property *AdtTree::AddProperty(Node *node, std::string_view name,
+                                        Ditto::span<const uint8_t> value) {
+  auto *name_field = static_cast<char *>(
+      m_arena.Allocate(sizeof(adt_property::name), alignof(char)));
+  memset(name_field, 0, sizeof(adt_property::name));
+  memcpy(name_field, name.data(),
+         std::min(name.size(), size_t{MAX_PROPERTY_NAME_LENGTH}));
+
+  auto *value_data =
+      static_cast<uint8_t *>(m_arena.Allocate(value.size(), ADT_ALIGN));
+  memcpy(value_data, value.data(), value.size());
+
+  auto *property = m_arena.New<Property>(Property{
+      nullptr, name_field, Ditto::span<uint8_t>{value_data, value.size()}});
+  LinkProperty(node, property);
+  return property;
+}
+
+void AdtTree::DeleteProperty(Node *node, Property *property) {
+  Property *previous = nullptr;
+  for (Property *prop = node->first_property; prop != property;
+       prop = prop->next) {
+    previous = prop;
+  }
+
+  if (previous == nullptr) {
+    node->first_property = property->next;
+  } else {
+    previous->next = property->next;
+  }
+  if (node->last_property == property) {
+    node->last_property = previous;
+  }
+  node->property_count--;
+  m_size -= property->Size();
+
+  // Another "name" property may take over
+  if (node->name == property) {
+    node->name = FindProperty(node, "name");
+  }
+}
+
+void AdtTree::Serialize(Ditto::span<uint8_t> out) const {
+  uint8_t *dst = out.data();
+
+  // Iterative pre-order walk, using the parent links to climb back up
+  const Node *node = m_root;
+  while (node != nullptr) {
+    const adt_node_hdr hdr{node->property_count, node->child_count};
+    memcpy(dst, &hdr, sizeof(hdr));
+    dst += sizeof(hdr);
+
+    for (const Property *prop = node->first_property; prop != nullptr;
+         prop = prop->next) {
+      const size_t size = prop->Size();
+      auto *wire = reinterpret_cast<adt_property *>(dst);
+      memcpy(wire->name, prop->name, sizeof(wire->name));
+      wire->size = prop->value.size() | prop->flags;
+      memcpy(&wire->value[0], prop->value.data(), prop->value.size());
+      memset(&wire->value[prop->value.size()], 0,
+             size - sizeof(adt_property) - prop->value.size());
+      dst += size;
+    }
+
+    if (node->first_child != nullptr) {
+      node = node->first_child;
+      continue;
+    }
+    while (node != nullptr && node->next_sibling == nullptr) {
+      node = node->parent;
+    }
+    if (node != nullptr) {
+      node = node->next_sibling;
+    }
+  }
+}
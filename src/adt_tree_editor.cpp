@@ -0,0 +1,180 @@
+#include "adt_tree_editor.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "adt_path_cache.h"
+#include "fmt/core.h"
+
+using Error = AdtModder::Error;
+using Ditto::Result;
+
+Result<AdtTreeEditor, Error>
+AdtTreeEditor::Create(Ditto::span<uint8_t> adt) noexcept {
+  auto tree = AdtTree::Parse(adt);
+  if (tree.is_error()) {
+    fmt::print("AdtModder: Unable to parse the ADT, it is malformed\n");
+    return Error::MalformedAdt;
+  }
+  return AdtTreeEditor{std::move(tree.ok_value())};
+}
+
+AdtTree::Node *AdtTreeEditor::ResolveNode(std::string_view path) {
+  const std::string key = AdtPathCache::Normalize(path);
+  if (const auto it = m_paths.find(key); it != m_paths.cend()) {
+    return it->second;
+  }
+
+  // Walk down from the root, caching every prefix on the way
+  AdtTree::Node *node = m_tree.Root();
+  size_t pos = 1;
+  while (pos < key.size()) {
+    size_t end = key.find('/', pos);
+    if (end == std::string::npos) {
+      end = key.size();
+    }
+
+    const std::string prefix = key.substr(0, end);
+    if (const auto it = m_paths.find(prefix); it != m_paths.cend()) {
+      node = it->second;
+    } else {
+      node = AdtTree::FindChild(node, {&key[pos], end - pos});
+      if (node == nullptr) {
+        return nullptr;
+      }
+      m_paths.emplace(prefix, node);
+    }
+    pos = end + 1;
+  }
+  return node;
+}
+
+void AdtTreeEditor::OnRename(const AdtTree::Node *node) {
+  // The root is never looked up by name
+  const AdtTree::Node *parent = node->parent;
+  if (parent == nullptr) {
+    return;
+  }
+  std::erase_if(m_paths, [parent](const auto &entry) {
+    for (const AdtTree::Node *ancestor = entry.second->parent;
+         ancestor != nullptr; ancestor = ancestor->parent) {
+      if (ancestor == parent) {
+        return true;
+      }
+    }
+    return false;
+  });
+}
+
+Result<AdtModder::Node, Error>
+AdtTreeEditor::FindNode(std::string_view path) {
+  m_counters.path_lookups++;
+  AdtTree::Node *node = ResolveNode(path);
+  if (node == nullptr) {
+    fmt::print("Could not find node \"{}\"\n", path);
+    return Error::NodeNotFound;
+  }
+  return AdtModder::Node{0, node};
+}
+
+void AdtTreeEditor::PinNodes(Ditto::span<const uint32_t> nodes) {
+  const std::unordered_set<uint32_t> pinned{nodes.begin(), nodes.end()};
+  // Nothing was edited yet, so the nodes of the tree are visited in the
+  // order of the index
+  uint32_t position = 0;
+  AdtTree::Node *node = m_tree.Root();
+  while (node != nullptr) {
+    if (pinned.contains(position)) {
+      m_pinned.emplace(position, node);
+    }
+    position++;
+
+    if (node->first_child != nullptr) {
+      node = node->first_child;
+      continue;
+    }
+    while (node != nullptr && node->next_sibling == nullptr) {
+      node = node->parent;
+    }
+    if (node != nullptr) {
+      node = node->next_sibling;
+    }
+  }
+}
+
+Result<AdtModder::Node, Error> AdtTreeEditor::FindPinnedNode(uint32_t node) {
+  const auto it = m_pinned.find(node);
+  if (it == m_pinned.cend()) {
+    return Error::NodeNotFound;
+  }
+  return AdtModder::Node{0, it->second};
+}
+
+Result<Ditto::span<uint8_t>, Error>
+AdtTreeEditor::FindProperty(AdtModder::Node node, std::string_view name) {
+  m_counters.property_lookups++;
+  AdtTree::Property *prop = AdtTree::FindProperty(TreeNode(node), name);
+  if (prop == nullptr) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+  // The value is handed out writable, so the node may be renamed through it
+  if (name == "name") {
+    OnRename(TreeNode(node));
+  }
+  return prop->value;
+}
+
+AdtModder::Result AdtTreeEditor::AddNode(std::string_view path) {
+  m_counters.path_lookups += 2;
+  if (ResolveNode(path) != nullptr) {
+    return Error::NodeAlreadyExists;
+  }
+
+  const auto last_node_separator_index = path.find_last_of('/');
+  const std::string_view parent_node_name =
+      path.substr(0, last_node_separator_index);
+  const std::string_view child_node_name =
+      path.substr(last_node_separator_index + 1);
+
+  AdtTree::Node *parent = ResolveNode(parent_node_name);
+  if (parent == nullptr) {
+    fmt::print("Parent node does not exist: {}", parent_node_name);
+    return Error::NodeNotFound;
+  }
+
+  m_paths.insert_or_assign(AdtPathCache::Normalize(path),
+                           m_tree.AddChild(parent, child_node_name));
+  m_counters.peak_adt_size =
+      std::max<uint64_t>(m_counters.peak_adt_size, m_tree.Size());
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result
+AdtTreeEditor::AddProperty(AdtModder::Node node, std::string_view name,
+                           Ditto::span<const uint8_t> value) {
+  m_tree.AddProperty(TreeNode(node), name, value);
+  if (name == "name") {
+    OnRename(TreeNode(node));
+  }
+  m_counters.peak_adt_size =
+      std::max<uint64_t>(m_counters.peak_adt_size, m_tree.Size());
+  return AdtModder::Result::ok();
+}
+
+AdtModder::Result AdtTreeEditor::DeleteProperty(AdtModder::Node node,
+                                                std::string_view name) {
+  m_counters.property_lookups++;
+  AdtTree::Node *tree_node = TreeNode(node);
+  AdtTree::Property *prop = AdtTree::FindProperty(tree_node, name);
+  if (prop == nullptr) {
+    fmt::print("Could not find property \"{}\"\n", name);
+    return Error::PropertyNotFound;
+  }
+
+  m_tree.DeleteProperty(tree_node, prop);
+  if (name == "name") {
+    OnRename(tree_node);
+  }
+  return AdtModder::Result::ok();
+}
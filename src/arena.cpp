@@ -0,0 +1,21 @@
+#include "arena.h"
+
+#include <algorithm>
+
+void *Arena::Allocate(size_t size, size_t alignment) {
+  size_t padding =
+      -reinterpret_cast<uintptr_t>(m_cursor) & (alignment - 1);
+  if (m_cursor == nullptr || padding + size > m_remaining) {
+    // Oversized allocations get a chunk of their own
+    const size_t chunk_size = std::max(m_chunk_size, size + alignment);
+    m_chunks.emplace_back(new uint8_t[chunk_size]);
+    m_cursor = m_chunks.back().get();
+    m_remaining = chunk_size;
+    padding = -reinterpret_cast<uintptr_t>(m_cursor) & (alignment - 1);
+  }
+
+  uint8_t *allocation = m_cursor + padding;
+  m_cursor = allocation + size;
+  m_remaining -= padding + size;
+  return allocation;
+}
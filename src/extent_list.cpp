@@ -0,0 +1,80 @@
+#include "extent_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+void ExtentList::Append(const uint8_t *data, size_t size,
+                        size_t input_offset) {
+  if (size == 0) {
+    return;
+  }
+  m_size += size;
+
+  // Coalesce with the previous extent when both are contiguous
+  if (!m_extents.empty()) {
+    Extent &last = m_extents.back();
+    const bool contiguous_data = last.data + last.size == data;
+    const bool contiguous_input =
+        input_offset == kNotInInput
+            ? last.input_offset == kNotInInput
+            : last.input_offset != kNotInInput &&
+                  last.input_offset + last.size == input_offset;
+    if (contiguous_data && contiguous_input) {
+      last.size += size;
+      return;
+    }
+  }
+  m_extents.push_back({data, size, input_offset});
+}
+
+void ExtentList::AddInput(size_t offset, size_t size) {
+  const size_t end = offset + size;
+
+  // First modified range that ends after the start of this one
+  auto it = std::upper_bound(
+      m_modified.cbegin(), m_modified.cend(), offset,
+      [](size_t offset, const Range &range) {
+        return offset < range.offset + range.size;
+      });
+
+  while (offset < end) {
+    if (it == m_modified.cend() || it->offset >= end) {
+      Append(&m_input[offset], end - offset, offset);
+      return;
+    }
+
+    if (it->offset > offset) {
+      Append(&m_input[offset], it->offset - offset, offset);
+      offset = it->offset;
+    }
+
+    const size_t modified_end = std::min(it->offset + it->size, end);
+    Append(&m_input[offset], modified_end - offset, kNotInInput);
+    offset = modified_end;
+    ++it;
+  }
+}
+
+void ExtentList::AddBuffer(Ditto::span<const uint8_t> buffer) {
+  Append(buffer.data(), buffer.size(), kNotInInput);
+}
+
+void ExtentList::AddBuffer(std::vector<uint8_t> buffer) {
+  // Moving the vector keeps its storage where it is
+  m_buffers.push_back(std::move(buffer));
+  Append(m_buffers.back().data(), m_buffers.back().size(), kNotInInput);
+}
+
+uint8_t *ExtentList::AddBytes(size_t size) {
+  auto *bytes = static_cast<uint8_t *>(m_arena.Allocate(size, alignof(int)));
+  Append(bytes, size, kNotInInput);
+  return bytes;
+}
+
+void ExtentList::CopyTo(Ditto::span<uint8_t> out) const {
+  uint8_t *dst = out.data();
+  for (const Extent &extent : m_extents) {
+    memcpy(dst, extent.data, extent.size);
+    dst += extent.size;
+  }
+}
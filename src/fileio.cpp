@@ -1,8 +1,15 @@
 #include "fileio.h"
 
+#include <algorithm>
+
+#include <climits>
+#include <cstdio>
+
 #include <fcntl.h>
 #include <sys/errno.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -28,7 +35,46 @@ File::Error File::ErrorFromErrno(int error_var) {
   }
 }
 Result<File, File::Error> File::Create(const char *name) {
-  int fd = open(name, O_RDWR | O_CREAT, S_IRWXU | S_IRWXG | S_IROTH);
+  int fd =
+      open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU | S_IRWXG | S_IROTH);
+  if (fd < 0) {
+    return File::ErrorFromErrno(errno);
+  }
+  return File{fd};
+}
+
+Result<File, File::Error>
+File::CreateTemporary(const std::string &path, std::string &temp_path) {
+  temp_path = path + ".XXXXXX";
+  int fd = mkstemp(temp_path.data());
+  if (fd < 0) {
+    return File::ErrorFromErrno(errno);
+  }
+
+  // mkstemp only grants access to the owner. Keep the permissions of the
+  // file being replaced, if there is one.
+  struct stat stats;
+  mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+  if (stat(path.c_str(), &stats) == 0) {
+    mode = stats.st_mode & 07777;
+  }
+  fchmod(fd, mode);
+
+  return File{fd};
+}
+
+Result<void, File::Error> File::Rename(const std::string &from,
+                                       const std::string &to) {
+  if (rename(from.c_str(), to.c_str()) < 0) {
+    return File::ErrorFromErrno(errno);
+  }
+  return Result<void, Error>::ok();
+}
+
+void File::Remove(const std::string &path) { unlink(path.c_str()); }
+
+Result<File, File::Error> File::OpenReadWrite(const char *name) {
+  int fd = open(name, O_RDWR);
   if (fd < 0) {
     return File::ErrorFromErrno(errno);
   }
@@ -79,15 +125,167 @@ Result<std::vector<uint8_t>, File::Error> File::ReadAll() {
   return data;
 }
 
+Result<size_t, File::Error> File::ReadSome(Ditto::span<uint8_t> buffer) {
+  while (true) {
+    const auto read_size = read(m_fd, buffer.data(), buffer.size());
+    if (read_size >= 0) {
+      return static_cast<size_t>(read_size);
+    }
+    if (errno != EINTR) {
+      return ErrorFromErrno(errno);
+    }
+  }
+}
+
+Result<File::Mapping, File::Error> File::Map(MapMode mode) const {
+  const auto size = DITTO_PROPAGATE(Size());
+  if (size == 0) {
+    // mmap rejects empty mappings
+    return Mapping{nullptr, 0};
+  }
+
+  int prot = PROT_READ;
+  int flags = MAP_PRIVATE;
+  if (mode != MapMode::ReadOnly) {
+    prot |= PROT_WRITE;
+  }
+  if (mode == MapMode::Shared) {
+    flags = MAP_SHARED;
+  }
+
+  void *address = mmap(nullptr, size, prot, flags, m_fd, 0);
+  if (address == MAP_FAILED) {
+    return ErrorFromErrno(errno);
+  }
+  return Mapping{address, size};
+}
+
+Result<void, File::Error> File::WriteAt(size_t offset,
+                                        Ditto::span<const uint8_t> buffer) {
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const auto write_size =
+        pwrite(m_fd, &buffer[written], buffer.size() - written,
+               static_cast<off_t>(offset + written));
+    if (write_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return File::ErrorFromErrno(errno);
+    }
+    written += write_size;
+  }
+
+  return Result<void, Error>::ok();
+}
+
 Result<void, File::Error> File::Write(Ditto::span<uint8_t> buffer) {
-  const auto write_size = write(m_fd, buffer.data(), buffer.size());
-  if (write_size < 0) {
-    return File::ErrorFromErrno(errno);
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const auto write_size =
+        write(m_fd, &buffer[written], buffer.size() - written);
+    if (write_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return File::ErrorFromErrno(errno);
+    }
+    written += write_size;
+  }
+
+  return Result<void, Error>::ok();
+}
+
+Result<void, File::Error> File::WriteVector(struct iovec *iov, int count) {
+  while (count > 0) {
+    auto write_size = writev(m_fd, iov, count);
+    if (write_size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return File::ErrorFromErrno(errno);
+    }
+
+    // Skip whatever was written, which may end in the middle of a buffer
+    while (count > 0 && static_cast<size_t>(write_size) >= iov->iov_len) {
+      write_size -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + write_size;
+      iov->iov_len -= write_size;
+    }
   }
 
   return Result<void, Error>::ok();
 }
 
+size_t File::CopyRange(const File &input, size_t offset, size_t size) {
+  size_t copied = 0;
+#ifdef __linux__
+  auto in_offset = static_cast<loff_t>(offset);
+  while (copied < size) {
+    const auto result = copy_file_range(input.m_fd, &in_offset, m_fd,
+                                        nullptr, size - copied, 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      // Not supported between these files, or failed halfway through
+      break;
+    }
+    copied += result;
+  }
+#else
+  static_cast<void>(input);
+  static_cast<void>(offset);
+  static_cast<void>(size);
+#endif
+  return copied;
+}
+
+Result<void, File::Error> File::WriteExtents(const ExtentList &extents,
+                                             const File *input) {
+  std::vector<struct iovec> iov;
+  iov.reserve(std::min<size_t>(extents.Extents().size(), IOV_MAX));
+  bool can_copy = input != nullptr;
+
+  for (const auto &extent : extents.Extents()) {
+    // Large unchanged ranges go straight from the input file
+    if (can_copy && extent.input_offset != ExtentList::kNotInInput &&
+        extent.size >= kCopyThreshold) {
+      auto result = WriteVector(iov.data(), iov.size());
+      if (result.is_error()) {
+        return result;
+      }
+      iov.clear();
+
+      const size_t copied =
+          CopyRange(*input, extent.input_offset, extent.size);
+      if (copied == extent.size) {
+        continue;
+      }
+
+      // Write the rest from memory, and stop trying from now on
+      can_copy = false;
+      iov.push_back({const_cast<uint8_t *>(extent.data) + copied,
+                     extent.size - copied});
+    } else {
+      iov.push_back({const_cast<uint8_t *>(extent.data), extent.size});
+    }
+    if (iov.size() == IOV_MAX) {
+      auto result = WriteVector(iov.data(), iov.size());
+      if (result.is_error()) {
+        return result;
+      }
+      iov.clear();
+    }
+  }
+
+  return WriteVector(iov.data(), iov.size());
+}
+
 File::File(File &&other) : m_fd(other.m_fd) { other.m_fd = -1; }
 
 File &File::operator=(File &&other) {
@@ -103,6 +301,35 @@ File &File::operator=(File &&other) {
   return *this;
 }
 
+File::Mapping::Mapping(Mapping &&other)
+    : m_address(other.m_address), m_size(other.m_size) {
+  other.m_address = nullptr;
+  other.m_size = 0;
+}
+
+File::Mapping &File::Mapping::operator=(Mapping &&other) {
+  if (this == &other)
+    return *this;
+
+  if (m_address != nullptr) {
+    munmap(m_address, m_size);
+  }
+  m_address = other.m_address;
+  m_size = other.m_size;
+  other.m_address = nullptr;
+  other.m_size = 0;
+
+  return *this;
+}
+
+File::Mapping::~Mapping() {
+  if (m_address == nullptr) {
+    return;
+  }
+
+  munmap(m_address, m_size);
+}
+
 File::~File() {
   if (m_fd < 0) {
     return;
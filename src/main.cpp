@@ -1,11 +1,519 @@
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <set>
+
+#include <unistd.h>
+
+#include "adt.h"
+#include "adt_address_map.h"
+#include "adt_builder.h"
+#include "adt_dump.h"
+#include "adt_index.h"
 #include "adt_modder.h"
+#include "adt_patch.h"
+#include "adt_server.h"
 #include "argparse/argparse.hpp"
 #include "fileio.h"
 #include "fmt/core.h"
-#include "nlohmann/json.hpp"
+#include "op_plan.h"
+#include "plan_cache.h"
+#include "result_cache.h"
+#include "run_stats.h"
+#include "thread_pool.h"
+
+// Writes the output to a temporary file next to the destination and renames
+// it over the destination once complete, so readers never see a partial ADT.
+Ditto::Result<void, File::Error> write_output(const std::string &dest_dt_name,
+                                              const ExtentList &extents,
+                                              const File &original_dt) {
+  std::string temp_name;
+  File temp =
+      DITTO_PROPAGATE(File::CreateTemporary(dest_dt_name, temp_name));
+
+  auto result = temp.WriteExtents(extents, &original_dt);
+  if (result.is_ok()) {
+    result = File::Rename(temp_name, dest_dt_name);
+  }
+  if (result.is_error()) {
+    File::Remove(temp_name);
+  }
+  return result;
+}
+
+// The whole ADT as extents, given the ranges layout-preserving ops touched
+ExtentList touched_extents(Ditto::span<uint8_t> data,
+                           const std::vector<AdtModder::Range> &touched) {
+  std::vector<ExtentList::Range> modified;
+  for (const auto &range : touched) {
+    modified.push_back({range.offset, range.size});
+  }
+
+  ExtentList extents{Ditto::span<const uint8_t>{data.data(), data.size()},
+                     std::move(modified)};
+  extents.AddInput(0, data.size());
+  return extents;
+}
+
+// Writes the result of a list of layout-preserving ops. When the output is
+// the input file, only the property values the ops had access to are written
+// back.
+Ditto::Result<void, File::Error>
+write_patch(const File &original_dt, Ditto::span<uint8_t> data,
+            const std::vector<AdtModder::Range> &touched,
+            const std::string &original_dt_name,
+            const std::string &dest_dt_name) {
+  std::error_code error;
+  if (!std::filesystem::equivalent(original_dt_name, dest_dt_name, error)) {
+    return write_output(dest_dt_name, touched_extents(data, touched),
+                        original_dt);
+  }
+
+  File dest_dt = DITTO_PROPAGATE(File::OpenReadWrite(dest_dt_name.c_str()));
+  for (const auto &range : touched) {
+    auto result = dest_dt.WriteAt(
+        range.offset,
+        Ditto::span<const uint8_t>{&data[range.offset], range.size});
+    if (result.is_error()) {
+      return result.error_value();
+    }
+  }
+
+  return Ditto::Result<void, File::Error>::ok();
+}
+
+enum class OutputFormat {
+  // The modified ADT
+  Adt,
+  // A binary patch from the input ADT to the modified one
+  Patch,
+};
+
+// Writes the patch from the input ADT to the output described by `extents`.
+// `data` is the input as mapped and modified in memory.
+Ditto::Result<void, std::string>
+write_adt_patch(const File &original_dt, Ditto::span<uint8_t> data,
+                const ExtentList &extents, const std::string &dest_name) {
+  auto original = original_dt.Map(File::MapMode::ReadOnly);
+  if (original.is_error()) {
+    return fmt::format("Unable to map the input: {}",
+                       File::error_to_string(original.error_value()));
+  }
+
+  const auto original_data = original.ok_value().Data();
+  const auto patch = AdtPatch::Diff(
+      {original_data.data(), original_data.size()}, {data.data(), data.size()},
+      extents);
+  ExtentList patch_extents{{}, {}};
+  patch_extents.AddBuffer(patch.Serialize());
+  auto result = write_output(dest_name, patch_extents, original_dt);
+  if (result.is_error()) {
+    return fmt::format("Unable to write {}: {}", dest_name,
+                       File::error_to_string(result.error_value()));
+  }
+  return Ditto::Result<void, std::string>::ok();
+}
+
+// Applies the ops to a single ADT. The input is mapped copy-on-write, so
+// layout-preserving op lists only copy the pages they write to. Errors are
+// returned as a message, so batch runs can report them per file.
+Ditto::Result<void, std::string>
+modify_uncached(AdtModder &modder, const OpPlan &plan,
+                const std::string &original_dt_name,
+                const std::string &dest_dt_name, OutputFormat format) {
+  auto original_dt = File::Open(original_dt_name.c_str());
+  if (original_dt.is_error()) {
+    return fmt::format("Unable to open {}: {}", original_dt_name,
+                       File::error_to_string(original_dt.error_value()));
+  }
+
+  auto mapping = original_dt.ok_value().Map(File::MapMode::Private);
+  if (mapping.is_error()) {
+    return fmt::format("Unable to map {}: {}", original_dt_name,
+                       File::error_to_string(mapping.error_value()));
+  }
+  const auto data = mapping.ok_value().Data();
+
+  if (plan.PreservesLayout()) {
+    auto touched = modder.RunInPlace(data, plan);
+    if (touched.is_error()) {
+      return fmt::format("Error running commands: {}",
+                         AdtModder::error_to_string(touched.error_value()));
+    }
+
+    if (format == OutputFormat::Patch) {
+      return write_adt_patch(original_dt.ok_value(), data,
+                             touched_extents(data, touched.ok_value()),
+                             dest_dt_name);
+    }
+
+    auto result = write_patch(original_dt.ok_value(), data,
+                              touched.ok_value(), original_dt_name,
+                              dest_dt_name);
+    if (result.is_error()) {
+      return fmt::format("Unable to write {}: {}", dest_dt_name,
+                         File::error_to_string(result.error_value()));
+    }
+    return Ditto::Result<void, std::string>::ok();
+  }
+
+  auto extents = modder.RunToExtents(data, plan);
+  if (extents.is_error()) {
+    return fmt::format("Error running commands: {}",
+                       AdtModder::error_to_string(extents.error_value()));
+  }
+
+  if (format == OutputFormat::Patch) {
+    return write_adt_patch(original_dt.ok_value(), data, extents.ok_value(),
+                           dest_dt_name);
+  }
+
+  auto result =
+      write_output(dest_dt_name, extents.ok_value(), original_dt.ok_value());
+  if (result.is_error()) {
+    return fmt::format("Unable to write {}: {}", dest_dt_name,
+                       File::error_to_string(result.error_value()));
+  }
+  return Ditto::Result<void, std::string>::ok();
+}
+
+// Applies the ops to a single ADT, serving the output from the result cache
+// when one is given and it holds the output for this input
+Ditto::Result<void, std::string> modify(AdtModder &modder, const OpPlan &plan,
+                                        const std::string &original_dt_name,
+                                        const std::string &dest_dt_name,
+                                        OutputFormat format,
+                                        const ResultCache *cache) {
+  if (cache == nullptr) {
+    return modify_uncached(modder, plan, original_dt_name, dest_dt_name,
+                           format);
+  }
+
+  std::string entry;
+  {
+    auto original_dt = File::Open(original_dt_name.c_str());
+    if (original_dt.is_error()) {
+      return fmt::format("Unable to open {}: {}", original_dt_name,
+                         File::error_to_string(original_dt.error_value()));
+    }
+    auto mapping = original_dt.ok_value().Map(File::MapMode::ReadOnly);
+    if (mapping.is_error()) {
+      return fmt::format("Unable to map {}: {}", original_dt_name,
+                         File::error_to_string(mapping.error_value()));
+    }
+    const auto data = mapping.ok_value().Data();
+    entry = cache->EntryPath({data.data(), data.size()});
+  }
+  if (ResultCache::Fetch(entry, dest_dt_name)) {
+    return Ditto::Result<void, std::string>::ok();
+  }
+
+  auto result =
+      modify_uncached(modder, plan, original_dt_name, dest_dt_name, format);
+  if (result.is_ok()) {
+    cache->Store(entry, dest_dt_name);
+  }
+  return result;
+}
+
+void add_output_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("--patch")
+      .help("Write a binary patch from the input ADT to the modified one "
+            "instead of the modified ADT. Implies --edit-log. See "
+            "\"adt_modder apply-patch\"")
+      .default_value(false)
+      .implicit_value(true);
+  program.add_argument("--result-cache")
+      .help("Directory caching the outputs of the ops, keyed by the input "
+            "ADT and the ops. Outputs found in it are copied instead of "
+            "being computed. Randomizing ops are only cached with --seed");
+}
+
+// Returns the result cache to use for the plan, if any. Outputs are only
+// reproducible if randomizing ops were given a seed.
+std::optional<ResultCache>
+get_result_cache(const argparse::ArgumentParser &program, const OpPlan &plan) {
+  const auto dir = program.present("--result-cache");
+  if (!dir.has_value()) {
+    return std::nullopt;
+  }
+  if (plan.IsRandomized() && !program.present("--seed").has_value()) {
+    fmt::print("Not using the result cache, the ops randomize without a "
+               "--seed\n");
+    return std::nullopt;
+  }
+  return ResultCache{*dir, ResultCache::PlanHash(
+                               plan, program.get<bool>("--patch") ? "patch"
+                                                                  : "adt")};
+}
+
+OutputFormat get_output_format(const argparse::ArgumentParser &program) {
+  return program.get<bool>("--patch") ? OutputFormat::Patch
+                                      : OutputFormat::Adt;
+}
+
+void add_mode_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("--edit-log")
+      .help("Defer structural edits and write the ADT out in a single pass")
+      .default_value(false)
+      .implicit_value(true);
+  program.add_argument("--tree")
+      .help("Parse the ADT into a tree, edit it and serialize it once")
+      .default_value(false)
+      .implicit_value(true);
+}
+
+AdtModder::Mode get_mode(const argparse::ArgumentParser &program) {
+  if (program.get<bool>("--edit-log") && program.get<bool>("--tree")) {
+    fmt::print("--edit-log and --tree are mutually exclusive\n");
+    std::exit(1);
+  }
+
+  if (program.get<bool>("--edit-log")) {
+    return AdtModder::Mode::EditLog;
+  }
+  if (program.get<bool>("--tree")) {
+    return AdtModder::Mode::Tree;
+  }
+  return AdtModder::Mode::Immediate;
+}
+
+// Mode of the commands that take output arguments. Only the edit log keeps
+// track of which output bytes come from the input, which is what patches are
+// made of.
+AdtModder::Mode get_run_mode(const argparse::ArgumentParser &program) {
+  const auto mode = get_mode(program);
+  return get_output_format(program) == OutputFormat::Patch
+             ? AdtModder::Mode::EditLog
+             : mode;
+}
+
+void add_plan_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("--no-plan-cache")
+      .help("Always compile the json ops instead of reusing a compiled plan "
+            "cached on disk")
+      .default_value(false)
+      .implicit_value(true);
+  program.add_argument("--seed")
+      .help("Seed for randomize_property, in decimal or 0x-prefixed hex. "
+            "Runs with the same seed write the same bytes. Defaults to a "
+            "random seed, which is printed");
+}
+
+// Returns the seed given on the command line, or picks a random one
+uint64_t get_seed(const argparse::ArgumentParser &program,
+                  const OpPlan &plan) {
+  if (const auto seed = program.present("--seed")) {
+    size_t end = 0;
+    try {
+      const uint64_t value = std::stoull(*seed, &end, 0);
+      if (end == seed->size()) {
+        return value;
+      }
+    } catch (const std::logic_error &) {
+    }
+    fmt::print("Invalid seed {}\n", *seed);
+    std::exit(1);
+  }
+
+  std::random_device device;
+  const uint64_t seed = (uint64_t{device()} << 32) | device();
+  if (plan.IsRandomized()) {
+    fmt::print("Randomizing with seed {:#x}\n", seed);
+  }
+  return seed;
+}
+
+void add_stats_argument(argparse::ArgumentParser &program) {
+  program.add_argument("--stats")
+      .help("Write per-op timings and counters of the run to the given file, "
+            "as json");
+}
+
+// Writes the stats report if one was requested
+void write_stats(const argparse::ArgumentParser &program,
+                 const RunStats &stats) {
+  const auto path = program.present("--stats");
+  if (!path.has_value()) {
+    return;
+  }
+
+  std::string report = stats.ToJson().dump(2) + "\n";
+  auto file = File::Create(path->c_str());
+  auto result = file.is_ok()
+                    ? file.ok_value().Write(
+                          {reinterpret_cast<uint8_t *>(report.data()),
+                           report.size()})
+                    : Ditto::Result<void, File::Error>{file.error_value()};
+  if (result.is_error()) {
+    fmt::print("Unable to write {}: {}\n", *path,
+               File::error_to_string(result.error_value()));
+  }
+}
+
+// Compiles the ops before any ADT is opened, so a malformed op file fails
+// without writing anything. Plans compiled from the same json are reused from
+// the plan cache unless it is disabled.
+Ditto::Result<OpPlan, File::Error>
+read_plan(const argparse::ArgumentParser &program) {
+  const auto op_path = program.get<std::string>("operations.json");
+  auto op_file = DITTO_PROPAGATE(File::Open(op_path.c_str()));
+  const auto op_data = DITTO_PROPAGATE(op_file.ReadAll());
+  const Ditto::span<const uint8_t> json_text{op_data.data(), op_data.size()};
+
+  const auto cache_dir = PlanCache::DefaultDirectory();
+  auto plan = !program.get<bool>("--no-plan-cache") && cache_dir.has_value()
+                  ? PlanCache{*cache_dir}.Get(json_text)
+                  : OpPlan::Parse(json_text);
+  if (plan.is_error()) {
+    fmt::print("Invalid operations in {}: {}\n", op_path,
+               AdtModder::error_to_string(plan.error_value()));
+    std::exit(1);
+  }
+  plan.ok_value().SetSeed(get_seed(program, plan.ok_value()));
+  return std::move(plan.ok_value());
+}
+
+// The inputs of a batch are either every regular file in a directory, or the
+// paths listed in a file, one per line.
+Ditto::Result<std::vector<std::string>, File::Error>
+list_inputs(const std::string &inputs) {
+  std::vector<std::string> paths;
+  if (std::filesystem::is_directory(inputs)) {
+    for (const auto &entry : std::filesystem::directory_iterator{inputs}) {
+      if (entry.is_regular_file()) {
+        paths.push_back(entry.path().string());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  auto list_file = DITTO_PROPAGATE(File::Open(inputs.c_str()));
+  const auto list = DITTO_PROPAGATE(list_file.ReadAll());
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = pos;
+    while (end < list.size() && list[end] != '\n') {
+      end++;
+    }
+    if (end > pos) {
+      paths.emplace_back(list.begin() + pos, list.begin() + end);
+    }
+    pos = end + 1;
+  }
+  return paths;
+}
+
+Ditto::Result<void, File::Error> run_batch(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder batch");
+
+  program.add_argument("inputs").help(
+      "Directory of input ADTs, or a file listing one input ADT per line");
+  program.add_argument("operations.json")
+      .help("A json file with the operations to perform on every dt");
+  program.add_argument("-o", "--output-dir")
+      .help("Directory the modified ADTs are written to, under their "
+            "original file name, or followed by .patch with --patch")
+      .default_value(std::string{"modded_adts"});
+  program.add_argument("-j", "--jobs")
+      .help("Number of worker threads, defaults to one per hardware thread")
+      .default_value(0)
+      .scan<'i', int>();
+  add_output_arguments(program);
+  add_mode_arguments(program);
+  add_plan_arguments(program);
+  add_stats_argument(program);
+  program.add_epilog(AdtModder{}.Help());
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
+  }
+
+  const std::string output_dir = program.get<std::string>("-o");
+  const OutputFormat format = get_output_format(program);
+  // Parse and validate the ops once for the whole batch
+  const auto plan = DITTO_PROPAGATE(read_plan(program));
+  const auto cache = get_result_cache(program, plan);
+  const auto inputs =
+      DITTO_PROPAGATE(list_inputs(program.get<std::string>("inputs")));
+
+  std::vector<std::string> outputs;
+  std::set<std::string> output_names;
+  for (const auto &input : inputs) {
+    auto name = std::filesystem::path{input}.filename().string();
+    if (format == OutputFormat::Patch) {
+      name += ".patch";
+    }
+    if (!output_names.insert(name).second) {
+      fmt::print("Several inputs would be written to {}\n", name);
+      std::exit(1);
+    }
+    outputs.push_back((std::filesystem::path{output_dir} / name).string());
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(output_dir, error);
+  if (error) {
+    fmt::print("Unable to create {}: {}\n", output_dir, error.message());
+    std::exit(1);
+  }
+
+  // Every worker gets its own modder and stats, and every input its own
+  // result slot
+  ThreadPool pool{static_cast<size_t>(std::max(program.get<int>("-j"), 0))};
+  const bool collect_stats = program.present("--stats").has_value();
+  std::vector<AdtModder> modders;
+  std::vector<RunStats> worker_stats(pool.Workers());
+  for (size_t i = 0; i < pool.Workers(); i++) {
+    modders.emplace_back(get_run_mode(program));
+    modders.back().SetVerbose(false);
+    if (collect_stats) {
+      modders.back().SetStats(&worker_stats[i]);
+    }
+  }
+
+  std::vector<std::optional<std::string>> errors(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    pool.Submit([&, i](size_t worker) {
+      auto result = modify(modders[worker], plan, inputs[i], outputs[i],
+                           format, cache ? &*cache : nullptr);
+      if (result.is_error()) {
+        errors[i] = std::move(result.error_value());
+      }
+    });
+  }
+  pool.Wait();
+
+  size_t failed = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (errors[i].has_value()) {
+      fmt::print("FAILED {}: {}\n", inputs[i], *errors[i]);
+      failed++;
+    } else {
+      fmt::print("ok     {}\n", inputs[i]);
+    }
+  }
+  fmt::print("{} of {} ADTs modified\n", inputs.size() - failed,
+             inputs.size());
+
+  RunStats stats;
+  for (const auto &worker : worker_stats) {
+    stats.Merge(worker);
+  }
+  write_stats(program, stats);
+
+  if (failed != 0) {
+    std::exit(1);
+  }
+  return Ditto::Result<void, File::Error>::ok();
+}
 
 Ditto::Result<void, File::Error> run(int argc, char *argv[]) {
-  AdtModder modder;
   argparse::ArgumentParser program("adt_modder");
 
   program.add_argument("device_tree").help("Input ADT to modify");
@@ -13,7 +521,17 @@ Ditto::Result<void, File::Error> run(int argc, char *argv[]) {
       .help("A json file with the operations to perform on the dt");
   program.add_argument("-o", "--output")
       .default_value(std::string{"modded_adt.bin"});
-  program.add_epilog(modder.Help());
+  add_output_arguments(program);
+  add_mode_arguments(program);
+  add_plan_arguments(program);
+  add_stats_argument(program);
+  program.add_epilog(
+      AdtModder{}.Help() +
+      "\nRun \"adt_modder batch --help\" to modify many ADTs at once\n"
+      "Run \"adt_modder apply-patch --help\" to apply a patch\n"
+      "Run \"adt_modder query --help\" to look up the address map\n"
+      "Run \"adt_modder dump --help\" to write an ADT as json\n"
+      "Run \"adt_modder build --help\" to compile json into an ADT\n");
 
   try {
     program.parse_args(argc, argv);
@@ -24,34 +542,311 @@ Ditto::Result<void, File::Error> run(int argc, char *argv[]) {
 
   const std::string original_dt_name = program.get<std::string>("device_tree");
   const std::string dest_dt_name = program.get<std::string>("-o");
-  const std::string op_path = program.get<std::string>("operations.json");
+  const auto plan = DITTO_PROPAGATE(read_plan(program));
 
-  auto op_file = DITTO_PROPAGATE(File::Open(op_path.c_str()));
-  auto op_data = DITTO_PROPAGATE(op_file.ReadAll());
-  const auto operations = nlohmann::json::parse(op_data);
+  AdtModder modder{get_run_mode(program)};
+  RunStats stats;
+  if (program.present("--stats").has_value()) {
+    modder.SetStats(&stats);
+  }
+  const auto cache = get_result_cache(program, plan);
+  auto result = modify(modder, plan, original_dt_name, dest_dt_name,
+                       get_output_format(program), cache ? &*cache : nullptr);
+  write_stats(program, stats);
+  if (result.is_error()) {
+    fmt::print("{}\n", result.error_value());
+    exit(1);
+  }
 
-  auto original_dt = DITTO_PROPAGATE(File::Open(original_dt_name.c_str()));
-  auto dt_data = DITTO_PROPAGATE(original_dt.ReadAll());
+  return Ditto::Result<void, File::Error>::ok();
+}
 
-  auto mod_result = modder.RunFromJson(dt_data, operations);
-  if (mod_result.is_error()) {
-    fmt::print("Error running commands: {}",
-               AdtModder::error_to_string(mod_result.error_value()));
-    exit(1);
+// Applies a patch written with --patch to the ADT it was made from, or
+// reverts it on the ADT it produced. Patches that keep the layout of the ADT
+// are written over the bytes they change, the others rewrite the file.
+Ditto::Result<void, File::Error> run_apply_patch(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder apply-patch");
+
+  program.add_argument("device_tree").help("ADT to patch in place");
+  program.add_argument("patch").help("Patch written with --patch");
+  program.add_argument("-r", "--reverse")
+      .help("Revert the patch on the ADT it produced")
+      .default_value(false)
+      .implicit_value(true);
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
+  }
+
+  const auto dt_name = program.get<std::string>("device_tree");
+  const auto patch_name = program.get<std::string>("patch");
+  auto patch_file = DITTO_PROPAGATE(File::Open(patch_name.c_str()));
+  const auto patch_data = DITTO_PROPAGATE(patch_file.ReadAll());
+  auto decoded =
+      AdtPatch::Deserialize({patch_data.data(), patch_data.size()});
+  if (decoded.is_error()) {
+    fmt::print("Invalid patch {}: {}\n", patch_name,
+               AdtModder::error_to_string(decoded.error_value()));
+    std::exit(1);
+  }
+  const AdtPatch patch = program.get<bool>("--reverse")
+                             ? decoded.ok_value().Inverse()
+                             : std::move(decoded.ok_value());
+
+  File dt = DITTO_PROPAGATE(File::OpenReadWrite(dt_name.c_str()));
+  const auto mapping = DITTO_PROPAGATE(dt.Map(File::MapMode::ReadOnly));
+  const auto data = mapping.Data();
+  auto extents = patch.Apply({data.data(), data.size()});
+  if (extents.is_error()) {
+    fmt::print("Unable to patch {}: {}\n", dt_name,
+               AdtModder::error_to_string(extents.error_value()));
+    std::exit(1);
+  }
+
+  if (!patch.PreservesLayout()) {
+    return write_output(dt_name, extents.ok_value(), dt);
+  }
+
+  for (const auto &record : patch.Records()) {
+    auto result = dt.WriteAt(
+        record.offset, Ditto::span<const uint8_t>{record.new_bytes.data(),
+                                                  record.new_bytes.size()});
+    if (result.is_error()) {
+      return result;
+    }
+  }
+  return Ditto::Result<void, File::Error>::ok();
+}
+
+// Lists the physical address windows of the nodes of an ADT, or the ones
+// containing an address, translated through the "ranges" of their ancestors
+Ditto::Result<void, File::Error> run_query(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder query");
+
+  program.add_argument("device_tree").help("ADT to query");
+  program.add_argument("-a", "--address")
+      .help("Only list the windows containing this physical address, in "
+            "decimal or 0x-prefixed hex. Nested windows are listed from the "
+            "outermost one");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
+  }
+
+  const auto dt_name = program.get<std::string>("device_tree");
+  File dt = DITTO_PROPAGATE(File::Open(dt_name.c_str()));
+  const auto mapping = DITTO_PROPAGATE(dt.Map(File::MapMode::ReadOnly));
+  const auto data = mapping.Data();
+  const auto index = AdtIndex::Build(data);
+  if (index.is_error()) {
+    fmt::print("{} is not a valid ADT\n", dt_name);
+    std::exit(1);
+  }
+  const auto map = AdtAddressMap::Build(data.data(), index.ok_value());
+
+  std::vector<AdtAddressMap::Window> found;
+  const auto address = program.present("--address");
+  if (address.has_value()) {
+    auto parsed = AdtModder::ParseU64(*address);
+    if (parsed.is_error()) {
+      fmt::print("Invalid address {}\n", *address);
+      std::exit(1);
+    }
+    found = map.Find(parsed.ok_value());
+    if (found.empty()) {
+      fmt::print("No node owns {:#x}\n", parsed.ok_value());
+      std::exit(1);
+    }
+  }
+
+  for (const auto &window : address.has_value() ? found : map.Windows()) {
+    fmt::print("{:#018x}-{:#018x} {} reg[{}]\n", window.address,
+               window.End(), index.ok_value().Path(data.data(), window.node),
+               window.entry);
+  }
+  return Ditto::Result<void, File::Error>::ok();
+}
+
+// Writes an ADT, or the subtree of one of its nodes, as json, see AdtDumper
+Ditto::Result<void, File::Error> run_dump(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder dump");
+
+  program.add_argument("device_tree").help("ADT to dump");
+  program.add_argument("-o", "--output")
+      .help("File to write the json to, - for the standard output")
+      .default_value(std::string{"-"});
+  program.add_argument("--path").help(
+      "Only dump the subtree of the node at this path");
+  program.add_argument("--typed")
+      .help("Write property values as strings when they look like one, "
+            "and tagged with their type otherwise, instead of in hex")
+      .default_value(false)
+      .implicit_value(true);
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
+  }
+
+  const auto dt_name = program.get<std::string>("device_tree");
+  File dt = DITTO_PROPAGATE(File::Open(dt_name.c_str()));
+  const auto mapping = DITTO_PROPAGATE(dt.Map(File::MapMode::ReadOnly));
+  const auto data = mapping.Data();
+  if (adt_validate(data.data(), data.size()) != 0) {
+    fmt::print("{} is not a valid ADT\n", dt_name);
+    std::exit(1);
+  }
+
+  int offset = 0;
+  if (const auto path = program.present("--path"); path.has_value()) {
+    offset = adt_path_offset(data.data(), path->c_str());
+    if (offset < 0) {
+      fmt::print("Could not find node \"{}\"\n", *path);
+      std::exit(1);
+    }
+  }
+
+  if (const auto name = AdtDumper::FindUnwritableName(data.data(), offset);
+      name.has_value()) {
+    fmt::print("Property name \"{}\" can't be written as json\n", *name);
+    std::exit(1);
+  }
+
+  // Files are written next to their destination and renamed over it once
+  // complete, like modified ADTs
+  const auto output = program.get<std::string>("-o");
+  if (output == "-") {
+    // The File closes its descriptor, so it gets a copy of stdout
+    const int fd = dup(STDOUT_FILENO);
+    if (fd < 0) {
+      return File::Error::IoError;
+    }
+    File out = File::FromDescriptor(fd);
+    return AdtDumper{out, program.get<bool>("--typed")}.Dump(data.data(),
+                                                             offset);
+  }
+
+  std::string temp_name;
+  File out = DITTO_PROPAGATE(File::CreateTemporary(output, temp_name));
+  auto result =
+      AdtDumper{out, program.get<bool>("--typed")}.Dump(data.data(), offset);
+  if (result.is_ok()) {
+    result = File::Rename(temp_name, output);
+  }
+  if (result.is_error()) {
+    File::Remove(temp_name);
+  }
+  return result;
+}
+
+// Compiles a json description of a tree, in the format dumps are written in,
+// into an ADT, see AdtBuilder
+Ditto::Result<void, File::Error> run_build(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder build");
+
+  program.add_argument("description.json").help("Tree to compile");
+  program.add_argument("-o", "--output")
+      .help("File to write the ADT to")
+      .required();
+  program.add_argument("--hex")
+      .help("Read string values as hex encoded bytes, like dumps without "
+            "--typed write them")
+      .default_value(false)
+      .implicit_value(true);
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
+  }
+
+  const auto description_name = program.get<std::string>("description.json");
+  File description = DITTO_PROPAGATE(File::Open(description_name.c_str()));
+  const auto mapping =
+      DITTO_PROPAGATE(description.Map(File::MapMode::ReadOnly));
+  const auto text = mapping.Data();
+  // Ordered, so properties are written in the order they are described in
+  const auto json = nlohmann::ordered_json::parse(
+      text.begin(), text.end(), nullptr, /*allow_exceptions=*/false);
+  if (json.is_discarded()) {
+    fmt::print("Unable to parse {}\n", description_name);
+    std::exit(1);
+  }
+
+  auto adt = AdtBuilder{program.get<bool>("--hex")}.Build(json);
+  if (adt.is_error()) {
+    fmt::print("{}\n", adt.error_value());
+    std::exit(1);
   }
 
-  File dest_dt = DITTO_PROPAGATE(File::Create(dest_dt_name.c_str()));
-  auto result = dest_dt.Write(dt_data);
+  const auto output = program.get<std::string>("-o");
+  std::string temp_name;
+  File out = DITTO_PROPAGATE(File::CreateTemporary(output, temp_name));
+  auto result = out.Write({adt.ok_value().data(), adt.ok_value().size()});
+  if (result.is_ok()) {
+    result = File::Rename(temp_name, output);
+  }
   if (result.is_error()) {
-    return result.error_value();
+    File::Remove(temp_name);
+  }
+  return result;
+}
+
+// Serves requests from other processes over a Unix socket, see AdtServer
+Ditto::Result<void, File::Error> run_serve(int argc, char *argv[]) {
+  argparse::ArgumentParser program("adt_modder serve");
+
+  program.add_argument("socket").help("Path of the Unix socket to listen on");
+  program.add_argument("-j", "--jobs")
+      .help("Number of requests run at once, defaults to one per hardware "
+            "thread")
+      .default_value(0)
+      .scan<'i', int>();
+  add_mode_arguments(program);
+  program.add_epilog(
+      "\nClients send one json request per line, naming a base ADT and an op "
+      "file:\n"
+      "  {\"adt\": \"base.bin\", \"ops\": \"ops.json\", \"seed\": 1, "
+      "\"patch\": false, \"output\": \"out.bin\"}\n"
+      "\"seed\", \"patch\" and \"output\" are optional. Without an output, "
+      "the result\nfollows the {\"ok\": true, \"size\": N} response line.\n");
+
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::runtime_error &exc) {
+    fmt::print("{}", exc.what());
+    std::exit(1);
   }
 
+  AdtServer server{get_mode(program)};
+  auto result =
+      server.Serve(program.get<std::string>("socket"),
+                   static_cast<size_t>(std::max(program.get<int>("-j"), 0)));
+  if (result.is_error()) {
+    fmt::print("{}\n", result.error_value());
+    std::exit(1);
+  }
   return Ditto::Result<void, File::Error>::ok();
 }
 
 int main(int argc, char *argv[]) {
-  srand(time(nullptr));
-  auto result = run(argc, argv);
+  const std::string_view command = argc > 1 ? argv[1] : "";
+  auto result = command == "batch"         ? run_batch(argc - 1, argv + 1)
+                : command == "apply-patch" ? run_apply_patch(argc - 1, argv + 1)
+                : command == "serve"       ? run_serve(argc - 1, argv + 1)
+                : command == "query"       ? run_query(argc - 1, argv + 1)
+                : command == "dump"        ? run_dump(argc - 1, argv + 1)
+                : command == "build"       ? run_build(argc - 1, argv + 1)
+                                           : run(argc, argv);
   if (result.is_error()) {
     fmt::print("Error running command {}",
                static_cast<uint32_t>(result.error_value()));
@@ -0,0 +1,386 @@
+#include "op_plan.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include "adt.h"
+#include "adt_compatible_index.h"
+#include "adt_selectors.h"
+#include "fmt/core.h"
+
+using Ditto::Result;
+using Error = AdtModder::Error;
+
+namespace {
+
+// Walks the op table, comparing names against the one of every op in turn
+template <size_t I = 0>
+Result<OpPlan::Op, Error> CompileOp(std::string_view name,
+                                    const nlohmann::json &command) noexcept {
+  if constexpr (I == std::variant_size_v<OpPlan::Op>) {
+    fmt::print("AdtModder: Unknown operation with name: \"{}\"\n", name);
+    return Error::InvalidOperation;
+  } else {
+    using Op = std::variant_alternative_t<I, OpPlan::Op>;
+    if (name != Op::kName) {
+      return CompileOp<I + 1>(name, command);
+    }
+
+    auto op = Op::Compile(command);
+    if (op.is_error()) {
+      fmt::print("AdtModder: Invalid operation \"{}\"\n", name);
+      return op.error_value();
+    }
+    return OpPlan::Op{std::in_place_index<I>, std::move(op.ok_value())};
+  }
+}
+
+// Binary plan format: a header followed by every op, as its index in the op
+// table and then each of its fields as a length-prefixed byte string. Numbers
+// are stored in native byte order, plans are only read on the machine that
+// wrote them.
+constexpr char kPlanMagic[8] = {'A', 'D', 'T', 'P', 'L', 'A', 'N', '\0'};
+// Bump whenever an op or its fields change, or what compiling them accepts
+constexpr uint32_t kPlanVersion = 3;
+
+struct PlanHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t op_count;
+};
+
+void PutU32(std::vector<uint8_t> &out, uint32_t value) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+template <typename T> void PutField(std::vector<uint8_t> &out, const T &field) {
+  PutU32(out, static_cast<uint32_t>(field.size()));
+  const auto *bytes = reinterpret_cast<const uint8_t *>(field.data());
+  out.insert(out.end(), bytes, bytes + field.size());
+}
+
+class PlanReader {
+public:
+  explicit PlanReader(Ditto::span<const uint8_t> data) : m_data(data) {}
+
+  bool Read(void *out, size_t size) {
+    if (size > m_data.size() - m_pos) {
+      return false;
+    }
+    memcpy(out, &m_data[m_pos], size);
+    m_pos += size;
+    return true;
+  }
+
+  // Reads a length-prefixed string or byte vector
+  template <typename T> bool ReadField(T &field) {
+    uint32_t size;
+    if (!Read(&size, sizeof(size)) || size > m_data.size() - m_pos) {
+      return false;
+    }
+    field.resize(size);
+    return Read(field.data(), size);
+  }
+
+  [[nodiscard]] bool AtEnd() const { return m_pos == m_data.size(); }
+
+private:
+  Ditto::span<const uint8_t> m_data;
+  size_t m_pos = 0;
+};
+
+template <size_t I = 0>
+Result<OpPlan::Op, Error> ReadOp(uint32_t index, PlanReader &reader) noexcept {
+  if constexpr (I == std::variant_size_v<OpPlan::Op>) {
+    return Error::MalformedJson;
+  } else {
+    if (index != I) {
+      return ReadOp<I + 1>(index, reader);
+    }
+
+    std::variant_alternative_t<I, OpPlan::Op> op;
+    const bool ok = std::apply(
+        [&](auto &...fields) { return (reader.ReadField(fields) && ...); },
+        op.Fields());
+    if (!ok) {
+      return Error::MalformedJson;
+    }
+    return OpPlan::Op{std::in_place_index<I>, std::move(op)};
+  }
+}
+
+std::string_view NodeOf(const OpPlan::Op &op) {
+  return std::visit([](const auto &op) -> std::string_view { return op.node; },
+                    op);
+}
+
+// Compatible string the nodes of an op are filtered by, empty if none
+std::string_view CompatibleOf(const OpPlan::Op &op) {
+  return std::visit(
+      [](const auto &op) -> std::string_view {
+        if constexpr (requires { op.compatible; }) {
+          return op.compatible;
+        } else {
+          return {};
+        }
+      },
+      op);
+}
+
+template <size_t... I>
+std::string HelpFor(std::index_sequence<I...>) {
+  std::string help;
+  ((help += fmt::format("Command \"{}\": {}\n",
+                        std::variant_alternative_t<I, OpPlan::Op>::kName,
+                        std::variant_alternative_t<I, OpPlan::Op>::kHelp)),
+   ...);
+  return help;
+}
+
+template <size_t... I>
+std::vector<std::string_view> NamesFor(std::index_sequence<I...>) {
+  return {std::variant_alternative_t<I, OpPlan::Op>::kName...};
+}
+
+} // namespace
+
+Result<OpPlan, Error> OpPlan::Compile(const nlohmann::json &op_array) noexcept {
+  if (!op_array.is_array()) {
+    fmt::print("AdtModder: Expected a json array.\n");
+    return Error::MalformedJson;
+  }
+
+  OpPlan plan;
+  plan.m_ops.reserve(op_array.size());
+  for (const auto &element : op_array) {
+    if (!element.is_object()) {
+      fmt::print("AdtModder: Expected a json object.\n");
+      return Error::MalformedJson;
+    }
+
+    if (!element.contains("name") || !element["name"].is_string()) {
+      fmt::print("All operation objects should have a \"name\" property\n");
+      return Error::MalformedJson;
+    }
+
+    plan.Append(DITTO_PROPAGATE(CompileOp(
+        element["name"].get_ref<const std::string &>(), element)));
+  }
+
+  return plan;
+}
+
+Result<OpPlan, Error>
+OpPlan::Parse(Ditto::span<const uint8_t> json_text) noexcept {
+  const auto json = nlohmann::json::parse(
+      json_text.begin(), json_text.end(), nullptr, /*allow_exceptions=*/false);
+  if (json.is_discarded()) {
+    fmt::print("AdtModder: Unable to parse json.\n");
+    return Error::MalformedJson;
+  }
+  return Compile(json);
+}
+
+std::vector<uint8_t> OpPlan::Serialize() const {
+  std::vector<uint8_t> out;
+  PlanHeader header;
+  memcpy(header.magic, kPlanMagic, sizeof(header.magic));
+  header.version = kPlanVersion;
+  header.op_count = static_cast<uint32_t>(m_ops.size());
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&header);
+  out.insert(out.end(), bytes, bytes + sizeof(header));
+
+  for (const auto &op : m_ops) {
+    PutU32(out, static_cast<uint32_t>(op.index()));
+    std::visit(
+        [&](const auto &op) {
+          std::apply(
+              [&](const auto &...fields) { (PutField(out, fields), ...); },
+              op.Fields());
+        },
+        op);
+  }
+  return out;
+}
+
+Result<OpPlan, Error>
+OpPlan::Deserialize(Ditto::span<const uint8_t> data) noexcept {
+  PlanReader reader{data};
+  PlanHeader header;
+  if (!reader.Read(&header, sizeof(header)) ||
+      memcmp(header.magic, kPlanMagic, sizeof(header.magic)) != 0 ||
+      header.version != kPlanVersion) {
+    return Error::MalformedJson;
+  }
+
+  OpPlan plan;
+  for (uint32_t i = 0; i < header.op_count; i++) {
+    uint32_t index;
+    if (!reader.Read(&index, sizeof(index))) {
+      return Error::MalformedJson;
+    }
+    plan.Append(DITTO_PROPAGATE(ReadOp(index, reader)));
+  }
+
+  if (!reader.AtEnd()) {
+    return Error::MalformedJson;
+  }
+  return plan;
+}
+
+Result<OpPlan, Error> OpPlan::Expand(Ditto::span<uint8_t> adt) const noexcept {
+  // Ops sharing a selector share its matches. Ops selecting every node
+  // compatible with a string are served by the compatible index instead.
+  constexpr size_t kCompatibleNodes = SIZE_MAX;
+  AdtSelectors selectors;
+  std::unordered_map<std::string_view, size_t> selector_ids;
+  std::vector<std::optional<size_t>> op_selectors;
+  bool any_compatible = false;
+  for (const auto &op : m_ops) {
+    const std::string_view node = NodeOf(op);
+    const std::string_view compatible = CompatibleOf(op);
+    any_compatible = any_compatible || !compatible.empty();
+    if (!compatible.empty() && node == "/**") {
+      op_selectors.push_back(kCompatibleNodes);
+      continue;
+    }
+    if (!AdtSelectors::IsPattern(node) && compatible.empty()) {
+      op_selectors.emplace_back();
+      continue;
+    }
+    auto [it, added] = selector_ids.try_emplace(node, 0);
+    if (added) {
+      it->second = selectors.Add(node);
+    }
+    op_selectors.push_back(it->second);
+  }
+
+  auto index = AdtIndex::Build(adt);
+  if (index.is_error()) {
+    fmt::print("AdtModder: Unable to match selectors on a malformed ADT\n");
+    return Error::MalformedAdt;
+  }
+  const auto matches = selectors.Match(adt.data(), index.ok_value());
+  std::optional<AdtCompatibleIndex> compatible_index;
+  if (any_compatible) {
+    compatible_index = AdtCompatibleIndex::Build(adt.data(), index.ok_value());
+  }
+
+  OpPlan plan;
+  plan.m_seed = m_seed;
+  std::vector<AdtSelectors::Hit> hits;
+  // Position of the node of every hit in the index
+  std::vector<uint32_t> hit_nodes;
+  for (size_t i = 0; i < m_ops.size(); i++) {
+    if (!op_selectors[i].has_value()) {
+      plan.Append(m_ops[i]);
+      plan.m_pins.push_back(AdtIndex::kNone);
+      continue;
+    }
+
+    const std::string_view compatible = CompatibleOf(m_ops[i]);
+    hits.clear();
+    hit_nodes.clear();
+    if (*op_selectors[i] == kCompatibleNodes) {
+      for (const uint32_t node : compatible_index->Find(compatible)) {
+        hits.push_back({index.ok_value().Path(adt.data(), node),
+                        index.ok_value()[node].offset});
+        hit_nodes.push_back(node);
+      }
+    } else {
+      // Compatible nodes are listed in the order of the index, which is the
+      // order of their offsets
+      const std::vector<uint32_t> *compatible_nodes =
+          compatible.empty() ? nullptr : &compatible_index->Find(compatible);
+      for (const auto &hit : matches[*op_selectors[i]]) {
+        const uint32_t node = index.ok_value().Find(hit.offset);
+        if (compatible_nodes == nullptr ||
+            std::binary_search(compatible_nodes->begin(),
+                               compatible_nodes->end(), node)) {
+          hits.push_back(hit);
+          hit_nodes.push_back(node);
+        }
+      }
+    }
+
+    if (hits.empty()) {
+      fmt::print("AdtModder: No node matches \"{}\"{}\n", NodeOf(m_ops[i]),
+                 compatible.empty()
+                     ? ""
+                     : fmt::format(" and is compatible with \"{}\"",
+                                   compatible));
+      return Error::NodeNotFound;
+    }
+    std::visit(
+        [&](const auto &op) {
+          using OpType = std::decay_t<decltype(op)>;
+          for (size_t j = 0; j < hits.size(); j++) {
+            const AdtSelectors::Hit &hit = hits[j];
+            if constexpr (OpType::kNeedsProperty) {
+              if (adt_get_property_namelen(adt.data(), hit.offset,
+                                           op.property.data(),
+                                           op.property.size()) == nullptr) {
+                continue;
+              }
+            }
+            OpType matched = op;
+            matched.node = hit.path;
+            if constexpr (requires { matched.compatible; }) {
+              matched.compatible.clear();
+            }
+            plan.Append(std::move(matched));
+            plan.m_pins.push_back(hit_nodes[j]);
+          }
+        },
+        m_ops[i]);
+  }
+  return plan;
+}
+
+void OpPlan::Append(Op op) {
+  m_preserves_layout =
+      m_preserves_layout &&
+      std::visit([](const auto &op) { return op.kPreservesLayout; }, op);
+  m_has_selectors = m_has_selectors || AdtSelectors::IsPattern(NodeOf(op)) ||
+                    !CompatibleOf(op).empty();
+  m_ops.push_back(std::move(op));
+}
+
+std::string_view OpPlan::Name(const Op &op) noexcept {
+  return std::visit([](const auto &op) { return op.kName; }, op);
+}
+
+std::optional<AdtModder::Target> OpPlan::GetTarget(const Op &op) noexcept {
+  return std::visit([](const auto &op) { return op.GetTarget(); }, op);
+}
+
+AdtModder::Result OpPlan::Run(const Op &op,
+                              AdtModder::Editor &editor) noexcept {
+  return std::visit([&](const auto &op) { return op.Run(editor); }, op);
+}
+
+void OpPlan::SetSeed(uint64_t seed) {
+  m_seed = seed;
+  for (auto &op : m_ops) {
+    if (auto *randomize = std::get_if<RandomizePropertyOp>(&op)) {
+      randomize->seed = seed;
+    }
+  }
+}
+
+bool OpPlan::IsRandomized() const {
+  return std::any_of(m_ops.begin(), m_ops.end(), [](const Op &op) {
+    return std::holds_alternative<RandomizePropertyOp>(op);
+  });
+}
+
+std::string OpPlan::Help() noexcept {
+  return HelpFor(std::make_index_sequence<std::variant_size_v<Op>>{});
+}
+
+std::vector<std::string_view> OpPlan::Names() noexcept {
+  return NamesFor(std::make_index_sequence<std::variant_size_v<Op>>{});
+}
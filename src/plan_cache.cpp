@@ -0,0 +1,104 @@
+#include "plan_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "fileio.h"
+#include "fmt/core.h"
+#include "utils.h"
+
+std::optional<std::string> PlanCache::DefaultDirectory() {
+  if (const char *dir = getenv("ADT_MODDER_CACHE_DIR"); dir && *dir) {
+    return std::string{dir};
+  }
+  if (const char *dir = getenv("XDG_CACHE_HOME"); dir && *dir) {
+    return (std::filesystem::path{dir} / "adt_modder").string();
+  }
+  if (const char *dir = getenv("HOME"); dir && *dir) {
+    return (std::filesystem::path{dir} / ".cache" / "adt_modder").string();
+  }
+  return std::nullopt;
+}
+
+Ditto::Result<OpPlan, AdtModder::Error>
+PlanCache::Get(Ditto::span<const uint8_t> json_text) {
+  const EntryHeader header{
+      json_text.size(), utils::hashBytes(json_text.data(), json_text.size())};
+  const auto path = EntryPath(header.json_hash);
+
+  auto cached = Load(path, header);
+  if (cached.has_value()) {
+    return std::move(*cached);
+  }
+
+  auto plan = DITTO_PROPAGATE(OpPlan::Parse(json_text));
+  Store(path, header, plan);
+  return plan;
+}
+
+std::string PlanCache::EntryPath(uint64_t json_hash) const {
+  return (std::filesystem::path{m_directory} /
+          fmt::format("{:016x}.plan", json_hash))
+      .string();
+}
+
+std::optional<OpPlan> PlanCache::Load(const std::string &path,
+                                      const EntryHeader &expected) const {
+  auto file = File::Open(path.c_str());
+  if (file.is_error()) {
+    return std::nullopt;
+  }
+  auto mapping = file.ok_value().Map(File::MapMode::ReadOnly);
+  if (mapping.is_error()) {
+    return std::nullopt;
+  }
+
+  const auto data = mapping.ok_value().Data();
+  EntryHeader header;
+  if (data.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.json_size != expected.json_size ||
+      header.json_hash != expected.json_hash) {
+    return std::nullopt;
+  }
+
+  auto plan = OpPlan::Deserialize(Ditto::span<const uint8_t>{
+      data.data() + sizeof(header), data.size() - sizeof(header)});
+  if (plan.is_error()) {
+    return std::nullopt;
+  }
+  return std::move(plan.ok_value());
+}
+
+void PlanCache::Store(const std::string &path, const EntryHeader &header,
+                      const OpPlan &plan) const {
+  std::error_code error;
+  std::filesystem::create_directories(m_directory, error);
+  if (error) {
+    return;
+  }
+
+  std::vector<uint8_t> entry(sizeof(header));
+  memcpy(entry.data(), &header, sizeof(header));
+  const auto serialized = plan.Serialize();
+  entry.insert(entry.end(), serialized.begin(), serialized.end());
+
+  // Written next to the entry and renamed over it, so concurrent runs never
+  // read a partial entry
+  std::string temp_name;
+  auto temp = File::CreateTemporary(path, temp_name);
+  if (temp.is_error()) {
+    return;
+  }
+  auto result = temp.ok_value().Write(
+      Ditto::span<uint8_t>{entry.data(), entry.size()});
+  if (result.is_ok()) {
+    result = File::Rename(temp_name, path);
+  }
+  if (result.is_error()) {
+    File::Remove(temp_name);
+  }
+}
@@ -0,0 +1,95 @@
+#include "result_cache.h"
+
+#include <filesystem>
+
+#include "fileio.h"
+#include "fmt/core.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+utils::Hash128 ResultCache::PlanHash(const OpPlan &plan,
+                                    std::string_view variant) {
+  auto bytes = plan.Serialize();
+  if (plan.IsRandomized()) {
+    const uint64_t seed = plan.Seed().value_or(0);
+    const auto *seed_bytes = reinterpret_cast<const uint8_t *>(&seed);
+    bytes.insert(bytes.end(), seed_bytes, seed_bytes + sizeof(seed));
+  }
+  bytes.insert(bytes.end(), variant.begin(), variant.end());
+  return utils::hash128(bytes.data(), bytes.size());
+}
+
+std::string
+ResultCache::EntryPath(Ditto::span<const uint8_t> input) const {
+  const auto input_hash = utils::hash128(input.data(), input.size());
+  return (fs::path{m_directory} /
+          fmt::format("{:016x}{:016x}-{:x}-{:016x}{:016x}.out",
+                      input_hash.high, input_hash.low, input.size(),
+                      m_plan_hash.high, m_plan_hash.low))
+      .string();
+}
+
+bool ResultCache::Fetch(const std::string &entry, const std::string &dest) {
+  std::error_code error;
+  if (!fs::is_regular_file(entry, error)) {
+    return false;
+  }
+
+  // Copied next to the destination and renamed over it, so the destination
+  // may be the input itself. Entries are read-only, copies are made
+  // writable like any other output.
+  std::string temp_name;
+  if (File::CreateTemporary(dest, temp_name).is_error()) {
+    return false;
+  }
+  fs::copy_file(entry, temp_name, fs::copy_options::overwrite_existing,
+                error);
+  if (!error) {
+    fs::permissions(temp_name, fs::perms::owner_write, fs::perm_options::add,
+                    error);
+  }
+  if (error || File::Rename(temp_name, dest).is_error()) {
+    File::Remove(temp_name);
+    return false;
+  }
+  return true;
+}
+
+void ResultCache::Store(const std::string &entry,
+                        const std::string &output) const {
+  std::error_code error;
+  fs::create_directories(m_directory, error);
+  if (error) {
+    return;
+  }
+
+  auto output_file = File::Open(output.c_str());
+  if (output_file.is_error()) {
+    return;
+  }
+  auto data = output_file.ok_value().ReadAll();
+  if (data.is_error()) {
+    return;
+  }
+
+  // Written next to the entry and renamed over it, so concurrent runs never
+  // read a partial entry
+  std::string temp_name;
+  auto temp = File::CreateTemporary(entry, temp_name);
+  if (temp.is_error()) {
+    return;
+  }
+  auto result = temp.ok_value().Write(
+      Ditto::span<uint8_t>{data.ok_value().data(), data.ok_value().size()});
+  fs::permissions(temp_name,
+                  fs::perms::owner_read | fs::perms::group_read |
+                      fs::perms::others_read,
+                  error);
+  if (result.is_ok() && !error) {
+    result = File::Rename(temp_name, entry);
+  }
+  if (result.is_error() || error) {
+    File::Remove(temp_name);
+  }
+}
@@ -0,0 +1,67 @@
+#include "run_stats.h"
+
+#include <algorithm>
+
+namespace {
+
+void Add(AdtModder::Counters &total, const AdtModder::Counters &counters) {
+  total.path_lookups += counters.path_lookups;
+  total.property_lookups += counters.property_lookups;
+  total.bytes_moved += counters.bytes_moved;
+  total.reallocations += counters.reallocations;
+  total.peak_adt_size =
+      std::max(total.peak_adt_size, counters.peak_adt_size);
+}
+
+nlohmann::json CountersToJson(const AdtModder::Counters &counters) {
+  return {
+      {"path_lookups", counters.path_lookups},
+      {"property_lookups", counters.property_lookups},
+      {"bytes_moved", counters.bytes_moved},
+      {"reallocations", counters.reallocations},
+      {"peak_adt_size", counters.peak_adt_size},
+  };
+}
+
+} // namespace
+
+void RunStats::Merge(const RunStats &other) {
+  if (ops.size() < other.ops.size()) {
+    ops.resize(other.ops.size());
+  }
+  for (size_t i = 0; i < other.ops.size(); i++) {
+    Op &op = ops[i];
+    const Op &other_op = other.ops[i];
+    op.name = other_op.name;
+    op.node = other_op.node;
+    op.fused = other_op.fused;
+    op.failures += other_op.failures;
+    op.wall_ns += other_op.wall_ns;
+    Add(op.counters, other_op.counters);
+  }
+
+  runs += other.runs;
+  wall_ns += other.wall_ns;
+  Add(totals, other.totals);
+}
+
+nlohmann::json RunStats::ToJson() const {
+  nlohmann::json json_ops = nlohmann::json::array();
+  for (const auto &op : ops) {
+    json_ops.push_back({
+        {"name", op.name},
+        {"node", op.node},
+        {"fused", op.fused},
+        {"failures", op.failures},
+        {"wall_ns", op.wall_ns},
+        {"counters", CountersToJson(op.counters)},
+    });
+  }
+
+  return {
+      {"runs", runs},
+      {"wall_ns", wall_ns},
+      {"totals", CountersToJson(totals)},
+      {"ops", std::move(json_ops)},
+  };
+}
@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t workers) {
+  if (workers == 0) {
+    workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (size_t i = 0; i < workers; i++) {
+    m_queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < workers; i++) {
+    m_threads.emplace_back([this, i] { Run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock{m_mutex};
+    m_stopping = true;
+  }
+  m_work_available.notify_all();
+
+  for (auto &thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(Task task) {
+  size_t queue;
+  {
+    std::lock_guard lock{m_mutex};
+    m_pending++;
+    queue = m_next_queue;
+    m_next_queue = (m_next_queue + 1) % m_queues.size();
+  }
+
+  {
+    std::lock_guard lock{m_queues[queue]->mutex};
+    m_queues[queue]->tasks.push_back(std::move(task));
+    m_queued++;
+  }
+
+  // Take the pool lock so a worker can't miss the wakeup between checking
+  // for work and going to sleep
+  { std::lock_guard lock{m_mutex}; }
+  m_work_available.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock lock{m_mutex};
+  m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool ThreadPool::Pop(size_t worker, Task &task) {
+  {
+    Queue &own = *m_queues[worker];
+    std::lock_guard lock{own.mutex};
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      m_queued--;
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < m_queues.size(); i++) {
+    Queue &victim = *m_queues[(worker + i) % m_queues.size()];
+    std::lock_guard lock{victim.mutex};
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      m_queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(size_t worker) {
+  while (true) {
+    Task task;
+    if (Pop(worker, task)) {
+      task(worker);
+
+      std::lock_guard lock{m_mutex};
+      if (--m_pending == 0) {
+        m_idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock lock{m_mutex};
+    m_work_available.wait(lock,
+                          [this] { return m_stopping || m_queued != 0; });
+    if (m_stopping && m_queued == 0) {
+      return;
+    }
+  }
+}
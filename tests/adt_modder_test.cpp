@@ -0,0 +1,883 @@
+// Regression tests for the ops, run in every mode on small ADTs built from
+// json descriptions, and unit tests of the pieces the ops are built on.
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "adt.h"
+#include "adt_address_map.h"
+#include "adt_builder.h"
+#include "adt_dump.h"
+#include "adt_index.h"
+#include "adt_modder.h"
+#include "adt_modder_c.h"
+#include "adt_patch.h"
+#include "adt_path_cache.h"
+#include "adt_tree_editor.h"
+#include "fileio.h"
+#include "fmt/core.h"
+#include "nlohmann/json.hpp"
+#include "op_plan.h"
+#include "philox.h"
+#include "plan_cache.h"
+#include "result_cache.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define EXPECT(condition)                                                      \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      fmt::print("{}:{}: expected {}\n", __FILE__, __LINE__, #condition);      \
+      g_failures++;                                                            \
+    }                                                                          \
+  } while (false)
+
+constexpr AdtModder::Mode kModes[] = {
+    AdtModder::Mode::Immediate,
+    AdtModder::Mode::EditLog,
+    AdtModder::Mode::Tree,
+};
+
+std::vector<uint8_t> Build(std::string_view description) {
+  auto adt =
+      AdtBuilder{false}.Build(nlohmann::ordered_json::parse(description));
+  if (adt.is_error()) {
+    fmt::print("Invalid test ADT: {}\n", adt.error_value());
+    std::abort();
+  }
+  return std::move(adt.ok_value());
+}
+
+AdtModder::Result Run(AdtModder::Mode mode, std::vector<uint8_t> &adt,
+                      std::string_view ops) {
+  return AdtModder{mode}.RunFromJson(adt, nlohmann::json::parse(ops));
+}
+
+// Contents of a file, empty if it can't be read
+std::vector<uint8_t> ReadFile(const std::string &name) {
+  auto file = File::Open(name.c_str());
+  if (file.is_error()) {
+    return {};
+  }
+  auto data = file.ok_value().ReadAll();
+  return data.is_ok() ? std::move(data.ok_value()) : std::vector<uint8_t>{};
+}
+
+bool WriteFile(const std::string &name, std::vector<uint8_t> data) {
+  auto file = File::Create(name.c_str());
+  return file.is_ok() &&
+         file.ok_value().Write({data.data(), data.size()}).is_ok();
+}
+
+bool IsError(const AdtModder::Result &result, AdtModder::Error error) {
+  return result.is_error() && result.error_value() == error;
+}
+
+// Whether the node at `offset` has a property of that name and value
+bool HasValueAt(std::vector<uint8_t> &adt, int offset, const char *name,
+                std::string_view value) {
+  if (offset < 0) {
+    return false;
+  }
+  u32 size;
+  const auto *found =
+      static_cast<const char *>(adt_getprop(adt.data(), offset, name, &size));
+  return found != nullptr && std::string_view{found, size} == value;
+}
+
+bool HasValue(std::vector<uint8_t> &adt, const char *path, const char *name,
+              std::string_view value) {
+  return HasValueAt(adt, adt_path_offset(adt.data(), path), name, value);
+}
+
+// Offset of the second child of the node at `path`, which paths can't name
+// when its name is a prefix of the first one
+int SecondChild(std::vector<uint8_t> &adt, const char *path) {
+  const int offset = adt_path_offset(adt.data(), path);
+  if (offset < 0) {
+    return offset;
+  }
+  return adt_next_sibling_offset(adt.data(),
+                                 adt_first_child_offset(adt.data(), offset));
+}
+
+constexpr std::string_view kBus = R"({
+  "name": "device-tree",
+  "children": [{"name": "bus", "children": [
+    {"name": "uart@5", "properties": {"x": "five"}},
+    {"name": "uart", "properties": {"x": "none"}}
+  ]}]
+})";
+
+// Ops after a rename address the node by its new name, even when the ops
+// around it could be fused
+void TestRenameInFusedRun(AdtModder::Mode mode) {
+  auto adt = Build(kBus);
+  EXPECT(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"},
+    {"name": "replace_property", "node": "/bus/uart@5", "property": "name",
+     "value": "zz"},
+    {"name": "zero_out_property", "node": "/bus/zz", "property": "x"}
+  ])")
+             .is_ok());
+  EXPECT(HasValue(adt, "/bus/zz", "x", std::string_view{"\0\0\0\0\0", 5}));
+  // "uart@5" matched "uart" before being renamed
+  EXPECT(HasValue(adt, "/bus/uart", "x", std::string_view{"none", 5}));
+}
+
+// Paths resolved before a node is renamed resolve again afterwards
+void TestRenameThenAddress(AdtModder::Mode mode) {
+  auto adt = Build(kBus);
+  EXPECT(IsError(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"},
+    {"name": "replace_property", "node": "/bus/uart@5", "property": "name",
+     "value": "zz"},
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"}
+  ])"),
+                 AdtModder::Error::NodeNotFound));
+
+  // Once "uart@5" is renamed, "uart" matches its sibling
+  adt = Build(kBus);
+  EXPECT(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"},
+    {"name": "replace_property", "node": "/bus/uart", "property": "name",
+     "value": "zz"},
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"}
+  ])")
+             .is_ok());
+  EXPECT(HasValue(adt, "/bus/uart", "x", std::string_view{"\0\0\0\0\0", 5}));
+
+  adt = Build(kBus);
+  EXPECT(IsError(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"},
+    {"name": "replace_property", "node": "/bus", "property": "name",
+     "value": "b2"},
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"}
+  ])"),
+                 AdtModder::Error::NodeNotFound));
+
+  adt = Build(kBus);
+  EXPECT(IsError(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"},
+    {"name": "delete_property", "node": "/bus/uart@5", "property": "name"},
+    {"name": "add_node", "node": "/bus/uart@5/child"}
+  ])"),
+                 AdtModder::Error::NodeNotFound));
+}
+
+// The top bit of property sizes is a flag real ADTs set, which is not part
+// of the size and is kept as it is
+void TestFlaggedPropertySize(AdtModder::Mode mode) {
+  auto adt = Build(kBus);
+  const int uart = adt_path_offset(adt.data(), "/bus/uart@5");
+  adt_get_property(adt.data(), uart, "x")->size |= 0x80000000;
+  EXPECT(adt_validate(adt.data(), adt.size()) == 0);
+
+  EXPECT(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"},
+    {"name": "add_property", "node": "/bus/uart@5", "property": "y",
+     "value": "added"},
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"}
+  ])")
+             .is_ok());
+  EXPECT(adt_validate(adt.data(), adt.size()) == 0);
+  EXPECT(HasValue(adt, "/bus/uart@5", "x", std::string_view{"\0\0\0\0\0", 5}));
+  EXPECT(HasValue(adt, "/bus/uart@5", "y", std::string_view{"added", 6}));
+  EXPECT(HasValue(adt, "/bus/uart", "x", std::string_view{"\0\0\0\0\0", 5}));
+  const int flagged = adt_path_offset(adt.data(), "/bus/uart@5");
+  EXPECT(flagged >= 0 &&
+         adt_get_property(adt.data(), flagged, "x")->size == 0x80000005);
+}
+
+// Ops expanded from a selector run on the nodes it matched, even where their
+// path resolves to a sibling listed first
+void TestSelectorSiblings(AdtModder::Mode mode) {
+  const std::string_view zeroed{"\0\0\0\0\0", 5};
+  auto adt = Build(kBus);
+  EXPECT(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/*", "property": "x"}
+  ])")
+             .is_ok());
+  EXPECT(HasValue(adt, "/bus/uart@5", "x", zeroed));
+  EXPECT(HasValueAt(adt, SecondChild(adt, "/bus"), "x", zeroed));
+
+  // Paths spelled out keep resolving to the first match, also when they are
+  // fused with expanded ops
+  adt = Build(kBus);
+  EXPECT(Run(mode, adt, R"([
+    {"name": "zero_out_property", "node": "/bus/*", "property": "x"},
+    {"name": "replace_property", "node": "/bus/uart", "property": "x",
+     "value": "FIVE"},
+    {"name": "add_property", "node": "/bus/*", "property": "y",
+     "value": "added"}
+  ])")
+             .is_ok());
+  EXPECT(HasValue(adt, "/bus/uart@5", "x", std::string_view{"FIVE", 5}));
+  EXPECT(HasValue(adt, "/bus/uart@5", "y", std::string_view{"added", 6}));
+  EXPECT(HasValueAt(adt, SecondChild(adt, "/bus"), "x", zeroed));
+  EXPECT(HasValueAt(adt, SecondChild(adt, "/bus"), "y",
+                    std::string_view{"added", 6}));
+}
+
+// Same for ops selecting nodes by compatible string, which are listed by
+// the compatible index rather than matched by path
+void TestCompatibleSiblings(AdtModder::Mode mode) {
+  const std::string_view zeroed{"\0\0\0\0\0", 5};
+  constexpr std::string_view kSerialBus = R"({
+    "name": "device-tree",
+    "children": [{"name": "bus", "children": [
+      {"name": "uart@5", "properties": {"compatible": "serial", "x": "five"}},
+      {"name": "uart", "properties": {"compatible": "serial", "x": "none"}}
+    ]}]
+  })";
+
+  for (const char *node : {"", R"("node": "/bus/*",)"}) {
+    auto adt = Build(kSerialBus);
+    EXPECT(Run(mode, adt,
+               fmt::format(R"([{{"name": "zero_out_property", {}
+                                 "compatible": "serial", "property": "x"}}])",
+                           node))
+               .is_ok());
+    EXPECT(HasValue(adt, "/bus/uart@5", "x", zeroed));
+    EXPECT(HasValueAt(adt, SecondChild(adt, "/bus"), "x", zeroed));
+  }
+}
+
+// Typed numbers are only made of digits, and fit their type
+void TestStrictNumbers(AdtModder::Mode mode) {
+  for (const char *contents :
+       {"", "0x", "garbage", "12abc", " 12", "-1", "+1", "0x0x5", "0xg",
+        "18446744073709551616"}) {
+    auto adt = Build(kBus);
+    EXPECT(IsError(Run(mode, adt,
+                       fmt::format(R"([{{"name": "add_property",
+                                        "node": "/bus/uart", "property": "y",
+                                        "value": {{"type": "u64",
+                                                   "contents": "{}"}}}}])",
+                                   contents)),
+                   AdtModder::Error::InvalidOperation));
+  }
+  auto adt = Build(kBus);
+  EXPECT(IsError(Run(mode, adt, R"([{"name": "add_property",
+    "node": "/bus/uart", "property": "y",
+    "value": {"type": "u32", "contents": "0x100000000"}}])"),
+                 AdtModder::Error::InvalidOperation));
+
+  EXPECT(Run(mode, adt, R"([{"name": "add_property",
+    "node": "/bus/uart", "property": "y",
+    "value": {"type": "u64", "contents": "0xFfffffffffffffff"}},
+    {"name": "add_property", "node": "/bus/uart", "property": "z",
+    "value": {"type": "u64", "contents": "18446744073709551615"}}])")
+             .is_ok());
+  const std::string_view max{"\xff\xff\xff\xff\xff\xff\xff\xff", 8};
+  EXPECT(HasValue(adt, "/bus/uart", "y", max));
+  EXPECT(HasValue(adt, "/bus/uart", "z", max));
+
+  // Elements of u64[] are 64-bit too
+  EXPECT(Run(mode, adt, R"([{"name": "add_property",
+    "node": "/bus/uart", "property": "w",
+    "value": {"type": "u64[]", "contents": ["0x100000001", "2"]}}])")
+             .is_ok());
+  EXPECT(HasValue(adt, "/bus/uart", "w",
+                  std::string_view{"\1\0\0\0\1\0\0\0\2\0\0\0\0\0\0\0", 16}));
+  EXPECT(IsError(Run(mode, adt, R"([{"name": "add_property",
+    "node": "/bus/uart", "property": "v",
+    "value": {"type": "u64[]", "contents": ["1", "1x"]}}])"),
+                 AdtModder::Error::InvalidOperation));
+}
+
+// Typed dumps of an edited ADT build back into the same bytes, with values
+// looking like strings, numbers of either width, and neither
+void TestTypedDumpRoundTrip(AdtModder::Mode mode) {
+  auto adt = Build(R"({
+    "name": "device-tree",
+    "properties": {"compatible": ["a,b", "c"], "empty": {"hex": ""}},
+    "children": [{"name": "node@1", "properties": {
+      "string": "abc", "eight": "1234567", "hex_digits": "00ff",
+      "u32": {"u32": 7}, "u32s": {"u32": [1, 4294967295]},
+      "u64": {"u64": 18446744073709551615}, "odd": {"hex": "0102ff"},
+      "binary": {"hex": "00ff0000"}
+    }}, {"name": {"hex": "6ee9"}}]
+  })");
+  EXPECT(Run(mode, adt, R"([
+    {"name": "add_property", "node": "/node", "property": "added",
+     "value": {"type": "u64", "contents": "0x1234"}},
+    {"name": "zero_out_property", "node": "/node", "property": "string"}
+  ])")
+             .is_ok());
+
+  std::string dump_name;
+  auto dump = File::CreateTemporary("adt_modder_test.json", dump_name);
+  EXPECT(dump.is_ok() &&
+         (AdtDumper{dump.ok_value(), true}.Dump(adt.data(), 0).is_ok()));
+  const auto json = ReadFile(dump_name);
+  File::Remove(dump_name);
+
+  auto rebuilt = AdtBuilder{false}.Build(
+      nlohmann::ordered_json::parse(json.begin(), json.end(), nullptr, false));
+  EXPECT(rebuilt.is_ok() && rebuilt.ok_value() == adt);
+
+  // Property names are object keys, which can't hold the name as it is
+  EXPECT(!AdtDumper::FindUnwritableName(adt.data(), 0).has_value());
+  const std::string_view property = "string";
+  auto name = std::search(adt.begin(), adt.end(), property.begin(),
+                          property.end());
+  EXPECT(name != adt.end());
+  if (name != adt.end()) {
+    *name = 0xe9;
+    EXPECT(AdtDumper::FindUnwritableName(adt.data(), 0) == "\xe9tring");
+  }
+}
+
+// The C interface gives the same result as the ops run directly, reports the
+// size needed when the output doesn't fit, and maps errors to its codes
+void TestCApi(AdtModder::Mode mode) {
+  constexpr std::string_view kOps = R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"},
+    {"name": "add_property", "node": "/bus/uart@5", "property": "y",
+     "value": "added"}
+  ])";
+  adt_modder_plan *plan = nullptr;
+  EXPECT(adt_modder_plan_compile(kOps.data(), kOps.size(), &plan) ==
+         ADT_MODDER_OK);
+  if (plan == nullptr) {
+    return;
+  }
+  EXPECT(!adt_modder_plan_preserves_layout(plan));
+
+  const auto adt = Build(kBus);
+  auto expected = adt;
+  EXPECT(Run(mode, expected, kOps).is_ok());
+
+  const auto c_mode = static_cast<adt_modder_mode>(mode);
+  std::vector<uint8_t> out(adt.size());
+  size_t size = 0;
+  EXPECT(adt_modder_run(plan, c_mode, adt.data(), adt.size(), out.data(),
+                        out.size(), &size) == ADT_MODDER_ERR_OUTPUT_TOO_SMALL);
+  EXPECT(size == expected.size());
+  out.resize(size);
+  EXPECT(adt_modder_run(plan, c_mode, adt.data(), adt.size(), out.data(),
+                        out.size(), &size) == ADT_MODDER_OK);
+  EXPECT(out == expected);
+
+  // In place, with room to grow
+  auto in_place = adt;
+  in_place.resize(expected.size());
+  EXPECT(adt_modder_run(plan, c_mode, in_place.data(), adt.size(),
+                        in_place.data(), in_place.size(),
+                        &size) == ADT_MODDER_OK);
+  EXPECT(in_place == expected);
+
+  // A root claiming more properties than fit
+  const uint32_t truncated[16] = {1000};
+  EXPECT(adt_modder_run(plan, c_mode, truncated, sizeof(truncated),
+                        out.data(), out.size(),
+                        &size) == ADT_MODDER_ERR_MALFORMED_ADT);
+  adt_modder_plan_free(plan);
+
+  constexpr std::string_view kMissing = R"([
+    {"name": "zero_out_property", "node": "/missing", "property": "x"}
+  ])";
+  EXPECT(adt_modder_plan_compile(kMissing.data(), kMissing.size(), &plan) ==
+         ADT_MODDER_OK);
+  if (plan != nullptr) {
+    EXPECT(adt_modder_plan_preserves_layout(plan));
+    EXPECT(adt_modder_run(plan, c_mode, adt.data(), adt.size(), out.data(),
+                          out.size(),
+                          &size) == ADT_MODDER_ERR_NODE_NOT_FOUND);
+    adt_modder_plan_free(plan);
+  }
+
+  EXPECT(adt_modder_plan_compile("[{", 2, &plan) ==
+         ADT_MODDER_ERR_MALFORMED_JSON);
+  EXPECT(adt_modder_op_count() > 0 && adt_modder_op_name(0) != nullptr);
+  EXPECT(std::string_view{adt_modder_strerror(
+             ADT_MODDER_ERR_NODE_NOT_FOUND)} == "Node not found");
+}
+
+// Plans are stored on a miss and read back from their entry on a hit.
+// Damaged entries are misses, and get replaced.
+void TestPlanCache() {
+  const std::string directory = "adt_modder_test_plans";
+  std::filesystem::remove_all(directory);
+  PlanCache cache{directory};
+  const auto text = [](std::string_view json) {
+    return Ditto::span<const uint8_t>{
+        reinterpret_cast<const uint8_t *>(json.data()), json.size()};
+  };
+  constexpr std::string_view kOps = R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"}
+  ])";
+
+  auto compiled = cache.Get(text(kOps));
+  EXPECT(compiled.is_ok());
+  const std::vector<std::filesystem::path> entries{
+      std::filesystem::directory_iterator{directory}, {}};
+  EXPECT(entries.size() == 1);
+  if (compiled.is_error() || entries.size() != 1) {
+    return;
+  }
+  const std::string entry = entries[0].string();
+  const auto stored = ReadFile(entry);
+
+  // An entry holding another plan after the json size and hash is trusted
+  auto other = OpPlan::Compile(nlohmann::json::parse(R"([
+    {"name": "zero_out_property", "node": "/bus/uart@5", "property": "x"}
+  ])"));
+  EXPECT(other.is_ok() && stored.size() > 2 * sizeof(uint64_t));
+  if (other.is_error() || stored.size() <= 2 * sizeof(uint64_t)) {
+    return;
+  }
+  std::vector<uint8_t> forged{stored.begin(),
+                              stored.begin() + 2 * sizeof(uint64_t)};
+  const auto other_plan = other.ok_value().Serialize();
+  forged.insert(forged.end(), other_plan.begin(), other_plan.end());
+  std::filesystem::remove(entry);
+  EXPECT(WriteFile(entry, forged));
+  auto hit = cache.Get(text(kOps));
+  EXPECT(hit.is_ok() && hit.ok_value().Serialize() == other_plan);
+
+  std::filesystem::remove(entry);
+  EXPECT(WriteFile(entry, {stored.begin(), stored.end() - 1}));
+  auto miss = cache.Get(text(kOps));
+  EXPECT(miss.is_ok() &&
+         miss.ok_value().Serialize() == compiled.ok_value().Serialize());
+  EXPECT(ReadFile(entry) == stored);
+
+  auto malformed = cache.Get(text("[{"));
+  EXPECT(malformed.is_error() &&
+         malformed.error_value() == AdtModder::Error::MalformedJson);
+  std::filesystem::remove_all(directory);
+}
+
+// Outputs served from the result cache are copies of the entry, so writing
+// to one in place leaves the entry intact. Entries are told apart by input
+// and by plan.
+void TestResultCache() {
+  const std::string directory = "adt_modder_test_cache";
+  std::filesystem::remove_all(directory);
+  auto plan = OpPlan::Compile(nlohmann::json::parse(R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"}
+  ])"));
+  EXPECT(plan.is_ok());
+  if (plan.is_error()) {
+    return;
+  }
+
+  const ResultCache cache{directory,
+                          ResultCache::PlanHash(plan.ok_value(), "adt")};
+  auto input = Build(kBus);
+  const std::string entry = cache.EntryPath({input.data(), input.size()});
+  EXPECT(!ResultCache::Fetch(entry, "adt_modder_test.out"));
+
+  const std::vector<uint8_t> output{'o', 'u', 't'};
+  EXPECT(WriteFile("adt_modder_test.out", output));
+  cache.Store(entry, "adt_modder_test.out");
+  std::filesystem::remove("adt_modder_test.out");
+  EXPECT(ResultCache::Fetch(entry, "adt_modder_test.out"));
+  EXPECT(ReadFile("adt_modder_test.out") == output);
+
+  auto served = File::OpenReadWrite("adt_modder_test.out");
+  const uint8_t modified[] = {'x'};
+  EXPECT(served.is_ok() &&
+         served.ok_value().WriteAt(0, {modified, sizeof(modified)}).is_ok());
+  EXPECT(ReadFile(entry) == output);
+
+  input[input.size() - 1] ^= 1;
+  EXPECT(cache.EntryPath({input.data(), input.size()}) != entry);
+  EXPECT(!(ResultCache::PlanHash(plan.ok_value(), "patch") ==
+           ResultCache::PlanHash(plan.ok_value(), "adt")));
+
+  std::filesystem::remove("adt_modder_test.out");
+  std::filesystem::remove_all(directory);
+}
+
+// Blocks of the stream match the Philox4x32-10 known-answer vectors of
+// Random123, whose counter the stream only sets the low half of
+void TestPhiloxKnownAnswers() {
+  using Block = std::array<uint32_t, 4>;
+  EXPECT((Philox{0}.Block(0) ==
+          Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+
+  const Philox philox{0x299f31d0a4093822};
+  EXPECT((philox.Block(0x85a308d3243f6a88) ==
+          Block{0xe69c9c31, 0xb5a3d762, 0xe733bfc1, 0x341a787c}));
+  const Block first = philox.Block(0);
+  const Block second{0xf9a58d27, 0xa8e41926, 0xf1a18f40, 0xb3702f6b};
+  EXPECT(philox.Block(1) == second);
+
+  // Fill() writes the blocks in order, the last one cut short
+  uint8_t out[20];
+  philox.Fill({out, sizeof(out)});
+  EXPECT(memcmp(out, first.data(), 16) == 0);
+  EXPECT(memcmp(out + 16, second.data(), 4) == 0);
+}
+
+// Bytes described by an extent list
+std::vector<uint8_t> Contents(const ExtentList &extents) {
+  std::vector<uint8_t> out(extents.Size());
+  extents.CopyTo({out.data(), out.size()});
+  return out;
+}
+
+// Patches turn the original into the modified ADT, survive serialization,
+// invert back, and refuse any other input
+void TestPatchRoundTrip() {
+  auto plan = OpPlan::Compile(nlohmann::json::parse(R"([
+    {"name": "zero_out_property", "node": "/bus/uart", "property": "x"},
+    {"name": "add_property", "node": "/bus/uart@5", "property": "y",
+     "value": "added"},
+    {"name": "add_node", "node": "/bus/new"}
+  ])"));
+  EXPECT(plan.is_ok());
+  if (plan.is_error()) {
+    return;
+  }
+
+  const auto original = Build(kBus);
+  auto work = original;
+  AdtModder modder{AdtModder::Mode::EditLog};
+  auto extents = modder.RunToExtents({work.data(), work.size()},
+                                     plan.ok_value());
+  EXPECT(extents.is_ok());
+  if (extents.is_error()) {
+    return;
+  }
+  const auto modified = Contents(extents.ok_value());
+  const auto patch = AdtPatch::Diff({original.data(), original.size()},
+                                    {work.data(), work.size()},
+                                    extents.ok_value());
+  EXPECT(!patch.PreservesLayout());
+
+  const auto serialized = patch.Serialize();
+  auto read = AdtPatch::Deserialize({serialized.data(), serialized.size()});
+  EXPECT(read.is_ok());
+  if (read.is_error()) {
+    return;
+  }
+  const AdtPatch *patches[] = {&patch, &read.ok_value()};
+  for (const AdtPatch *candidate : patches) {
+    auto applied = candidate->Apply({original.data(), original.size()});
+    EXPECT(applied.is_ok() && Contents(applied.ok_value()) == modified);
+  }
+
+  const auto inverse = patch.Inverse();
+  auto reverted = inverse.Apply({modified.data(), modified.size()});
+  EXPECT(reverted.is_ok() && Contents(reverted.ok_value()) == original);
+
+  auto mismatch = patch.Apply({modified.data(), modified.size()});
+  EXPECT(mismatch.is_error() &&
+         mismatch.error_value() == AdtModder::Error::PatchMismatch);
+  auto truncated = AdtPatch::Deserialize({serialized.data(), 8});
+  EXPECT(truncated.is_error() &&
+         truncated.error_value() == AdtModder::Error::MalformedPatch);
+}
+
+// Addresses inside nested windows find every window around them, translated
+// through the ranges of the bus, sorted by address
+void TestAddressMapNested() {
+  auto adt = Build(R"({
+    "name": "device-tree",
+    "properties": {"#address-cells": {"u32": 2}, "#size-cells": {"u32": 2}},
+    "children": [
+      {"name": "bus", "properties": {
+        "#address-cells": {"u32": 1}, "#size-cells": {"u32": 1},
+        "reg": {"u32": [0, 2, 1048576, 0]},
+        "ranges": {"u32": [0, 0, 2, 1048576]}
+      }, "children": [
+        {"name": "uart", "properties": {"reg": {"u32": [4096, 256]}}},
+        {"name": "timer", "properties": {
+          "reg": {"u32": [8192, 4096, 10240, 16]}
+        }}
+      ]},
+      {"name": "dram", "properties": {"reg": {"u32": [0, 1, 0, 1]}}}
+    ]
+  })");
+  auto index = AdtIndex::Build({adt.data(), adt.size()});
+  EXPECT(index.is_ok());
+  if (index.is_error()) {
+    return;
+  }
+  const auto map = AdtAddressMap::Build(adt.data(), index.ok_value());
+  EXPECT(map.Windows().size() == 5);
+
+  // Bus, then both entries of the timer, the second inside the first
+  const auto timer = map.Find(0x200002804);
+  EXPECT(timer.size() == 3);
+  if (timer.size() == 3) {
+    EXPECT(timer[0].node == 1 && timer[0].address == 0x200000000 &&
+           timer[0].size == 0x100000);
+    EXPECT(timer[1].node == 3 && timer[1].entry == 0 &&
+           timer[1].address == 0x200002000);
+    EXPECT(timer[2].node == 3 && timer[2].entry == 1 &&
+           timer[2].address == 0x200002800 && timer[2].size == 0x10);
+  }
+
+  const auto uart = map.Find(0x2000010ff);
+  EXPECT(uart.size() == 2 && uart[1].node == 2);
+  const auto dram = map.Find(0x1ffffffff);
+  EXPECT(dram.size() == 1 && dram[0].node == 4);
+  // Windows exclude their end
+  EXPECT(map.Find(0x200100000).empty());
+  EXPECT(map.Find(0x200001100).size() == 1);
+}
+
+// Result of validating `adt` after `corrupt` changed it
+template <typename Corrupt> int ValidateCorrupted(Corrupt corrupt) {
+  auto adt = Build(kBus);
+  corrupt(adt);
+  return adt_validate(adt.data(), adt.size());
+}
+
+// Validation accepts built ADTs and rejects every malformed header,
+// property and node name it checks for
+void TestValidateRejects() {
+  const auto header = [](std::vector<uint8_t> &adt) {
+    return reinterpret_cast<adt_node_hdr *>(adt.data());
+  };
+  const auto first_property = [](std::vector<uint8_t> &adt) {
+    return reinterpret_cast<adt_property *>(adt.data() +
+                                            sizeof(adt_node_hdr));
+  };
+
+  EXPECT(ValidateCorrupted([](std::vector<uint8_t> &) {}) == 0);
+  EXPECT(ValidateCorrupted([](std::vector<uint8_t> &adt) {
+           adt.resize(adt.size() - ADT_ALIGN);
+         }) == -ADT_ERR_BADLENGTH);
+  // One more child than there are nodes left
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           header(adt)->child_count++;
+         }) == -ADT_ERR_BADOFFSET);
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           header(adt)->property_count = 0;
+         }) == -ADT_ERR_BADOFFSET);
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           header(adt)->child_count = 4096;
+         }) == -ADT_ERR_BADOFFSET);
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           memset(first_property(adt)->name, 'a', 32);
+         }) == -ADT_ERR_BADVALUE);
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           first_property(adt)->size = 0x100000;
+         }) == -ADT_ERR_BADLENGTH);
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           first_property(adt)->size = adt.size();
+         }) == -ADT_ERR_BADLENGTH);
+
+  // Names must be strings, and every node but the root needs one
+  EXPECT(ValidateCorrupted([&](std::vector<uint8_t> &adt) {
+           adt_property *name = first_property(adt);
+           memset(name->value, 'x', name->size);
+         }) == -ADT_ERR_BADVALUE);
+  EXPECT(ValidateCorrupted([](std::vector<uint8_t> &adt) {
+           const int bus = adt_path_offset(adt.data(), "/bus");
+           adt_get_property(adt.data(), bus, "name")->name[1] = 'o';
+         }) == -ADT_ERR_BADVALUE);
+
+  uint8_t small[sizeof(adt_node_hdr)] = {};
+  EXPECT(adt_validate(small, 0x80000000) == -ADT_ERR_BADLENGTH);
+}
+
+// Whether two indexes describe the same nodes
+bool SameIndex(const AdtIndex &a, const AdtIndex &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    const AdtIndex::Node x = a[i];
+    const AdtIndex::Node y = b[i];
+    if (x.offset != y.offset || x.parent != y.parent ||
+        x.first_property != y.first_property ||
+        x.first_child != y.first_child || x.end != y.end ||
+        x.subtree_size != y.subtree_size || x.name != y.name ||
+        x.name_size != y.name_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// An index updated after each edit matches one built from the result
+void TestIndexUpdates() {
+  auto adt = Build(kBus);
+  auto built = AdtIndex::Build({adt.data(), adt.size()});
+  EXPECT(built.is_ok());
+  if (built.is_error()) {
+    return;
+  }
+  AdtIndex index = std::move(built.ok_value());
+  const auto rebuilt = [&adt]() {
+    return AdtIndex::Build({adt.data(), adt.size()}).ok_value();
+  };
+
+  // uart@5 is node 2, its new property goes at the end of its properties
+  const uint32_t uart = index[2].offset;
+  const uint32_t added = index[2].first_child;
+  size_t size = adt.size();
+  EXPECT(Run(AdtModder::Mode::Immediate, adt, R"([
+    {"name": "add_property", "node": "/bus/uart@5", "property": "y",
+     "value": "abc"}
+  ])")
+             .is_ok());
+  const uint32_t property_size = adt.size() - size;
+  index.OnPropertyAdded(adt.data(), uart, added, property_size);
+  EXPECT(SameIndex(index, rebuilt()));
+
+  const uint32_t bus = index[1].offset;
+  const uint32_t node = index[1].end;
+  size = adt.size();
+  EXPECT(Run(AdtModder::Mode::Immediate, adt, R"([
+    {"name": "add_node", "node": "/bus/new"}
+  ])")
+             .is_ok());
+  index.OnNodeAdded(adt.data(), bus, node, adt.size() - size);
+  EXPECT(SameIndex(index, rebuilt()));
+
+  EXPECT(Run(AdtModder::Mode::Immediate, adt, R"([
+    {"name": "delete_property", "node": "/bus/uart@5", "property": "y"}
+  ])")
+             .is_ok());
+  index.OnPropertyRemoved(adt.data(), uart, added, property_size);
+  EXPECT(SameIndex(index, rebuilt()));
+  EXPECT(index.Find(static_cast<int>(node - property_size)) == 4);
+}
+
+// Cached and pinned offsets after an edit shift with it, the ones inside
+// removed bytes are dropped, and nodes that were never pinned are not found
+void TestPathCacheShifts() {
+  auto adt = Build(kBus);
+  auto index = AdtIndex::Build({adt.data(), adt.size()});
+  EXPECT(index.is_ok());
+  if (index.is_error()) {
+    return;
+  }
+  const AdtIndex &nodes = index.ok_value();
+  AdtPathCache cache;
+  const int bus = cache.Resolve(nodes, adt.data(), "/bus");
+  const int uart = cache.Resolve(nodes, adt.data(), "/bus/uart");
+  EXPECT(bus > 0 && uart > bus);
+  cache.Pin(3, uart);
+  EXPECT(cache.Pinned(2) == AdtIndex::kNone);
+
+  cache.OnInsert(uart, 16);
+  EXPECT(cache.Resolve(nodes, adt.data(), "/bus") == bus);
+  EXPECT(cache.Resolve(nodes, adt.data(), "/bus/uart") == uart + 16);
+  EXPECT(cache.Pinned(3) == static_cast<uint32_t>(uart + 16));
+
+  cache.OnRemove(bus, 16);
+  EXPECT(cache.Pinned(3) == static_cast<uint32_t>(uart));
+  cache.OnRemove(uart - 4, 8);
+  EXPECT(cache.Pinned(3) == AdtIndex::kNone);
+}
+
+// Pinned nodes are found by their position in the index, others are not
+void TestTreePins() {
+  auto adt = Build(kBus);
+  auto editor = AdtTreeEditor::Create({adt.data(), adt.size()});
+  EXPECT(editor.is_ok());
+  if (editor.is_error()) {
+    return;
+  }
+  const uint32_t pins[] = {2};
+  editor.ok_value().PinNodes({pins, 1});
+  auto uart = editor.ok_value().FindPinnedNode(2);
+  auto path = editor.ok_value().FindNode("/bus/uart@5");
+  EXPECT(uart.is_ok() && path.is_ok() &&
+         uart.ok_value().handle == path.ok_value().handle);
+  auto missing = editor.ok_value().FindPinnedNode(3);
+  EXPECT(missing.is_error() &&
+         missing.error_value() == AdtModder::Error::NodeNotFound);
+}
+
+// Every width has a single form in descriptions: the typed objects of
+// add_property, whose u32 is 8 bytes wide, are rejected
+void TestBuilderTypedValues() {
+  const auto build = [](std::string_view value) {
+    return AdtBuilder{false}.Build(nlohmann::ordered_json::parse(
+        fmt::format(R"({{"properties": {{"v": {}}}}})", value)));
+  };
+  const auto size_of = [&](std::string_view value) -> int64_t {
+    auto adt = build(value);
+    if (adt.is_error()) {
+      return -1;
+    }
+    u32 size = 0;
+    adt_getprop(adt.ok_value().data(), 0, "v", &size);
+    return size;
+  };
+
+  EXPECT(size_of(R"({"u32": 7})") == 4);
+  EXPECT(size_of(R"({"u32": [1, 2]})") == 8);
+  EXPECT(size_of(R"({"u64": 7})") == 8);
+  EXPECT(size_of(R"({"hex": "010203"})") == 3);
+  EXPECT(size_of(R"(["a", "bc"])") == 5);
+  EXPECT(build(R"({"type": "u32", "contents": "7"})").is_error());
+  EXPECT(build(R"({"u32": 4294967296})").is_error());
+  EXPECT(build(R"({"u32": -1})").is_error());
+  EXPECT(build(R"({"hex": "0g"})").is_error());
+  EXPECT(build(R"([])").is_error());
+}
+
+struct Test {
+  const char *name;
+  void (*run)(AdtModder::Mode mode);
+};
+
+// Tests of components that don't depend on the mode, run once
+struct UnitTest {
+  const char *name;
+  void (*run)();
+};
+
+const Test kTests[] = {
+    {"rename_in_fused_run", TestRenameInFusedRun},
+    {"rename_then_address", TestRenameThenAddress},
+    {"flagged_property_size", TestFlaggedPropertySize},
+    {"selector_siblings", TestSelectorSiblings},
+    {"compatible_siblings", TestCompatibleSiblings},
+    {"strict_numbers", TestStrictNumbers},
+    {"typed_dump_round_trip", TestTypedDumpRoundTrip},
+    {"c_api", TestCApi},
+};
+
+const UnitTest kUnitTests[] = {
+    {"plan_cache", TestPlanCache},
+    {"result_cache", TestResultCache},
+    {"builder_typed_values", TestBuilderTypedValues},
+    {"philox_known_answers", TestPhiloxKnownAnswers},
+    {"index_updates", TestIndexUpdates},
+    {"patch_round_trip", TestPatchRoundTrip},
+    {"address_map_nested", TestAddressMapNested},
+    {"validate_rejects", TestValidateRejects},
+    {"path_cache_shifts", TestPathCacheShifts},
+    {"tree_pins", TestTreePins},
+};
+
+} // namespace
+
+int main() {
+  for (const Test &test : kTests) {
+    for (const AdtModder::Mode mode : kModes) {
+      const int failures = g_failures;
+      test.run(mode);
+      fmt::print("{} {} (mode {})\n",
+                 g_failures == failures ? "PASS" : "FAIL", test.name,
+                 static_cast<int>(mode));
+    }
+  }
+  for (const UnitTest &test : kUnitTests) {
+    const int failures = g_failures;
+    test.run();
+    fmt::print("{} {}\n", g_failures == failures ? "PASS" : "FAIL",
+               test.name);
+  }
+  return g_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}